@@ -0,0 +1,136 @@
+// Host check of the text formatters in src/c/text_fmt.h against snprintf, at every buffer size
+// from 0 up to one past the full output, so truncation and NUL termination are covered too.
+//
+// Run: cc -std=c99 -Wall -Wextra -o /tmp/fmt-test scripts/fmt-test.c && /tmp/fmt-test
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/c/text_fmt.h"
+
+#define MAX_OUT 64
+#define SENTINEL '#'
+
+typedef void (*FormatFn)(TextBuf *text, const void *arg);
+
+static int s_failures = 0;
+static int s_checks = 0;
+
+// Formats with fn into every buffer size and compares with the snprintf reference, including the
+// untouched bytes past the buffer.
+static void prv_check(const char *label, FormatFn fn, const void *arg, const char *expected) {
+  size_t full = strlen(expected);
+  for (size_t size = 0; size <= full + 1 && size <= MAX_OUT; ++size) {
+    char got[MAX_OUT + 1];
+    char want[MAX_OUT + 1];
+    memset(got, SENTINEL, sizeof(got));
+    memset(want, SENTINEL, sizeof(want));
+    TextBuf text = prv_fmt_begin(got, size);
+    fn(&text, arg);
+    snprintf(want, size, "%s", expected);
+    s_checks++;
+    if (memcmp(got, want, sizeof(got)) != 0 || (size > 0 && text.len != strlen(want))) {
+      s_failures++;
+      printf("FAIL %s size=%zu: got \"%.*s\" want \"%.*s\"\n", label, size,
+             (int)(size ? size - 1 : 0), got, (int)(size ? size - 1 : 0), want);
+    }
+  }
+}
+
+typedef struct {
+  uint32_t value;
+  uint8_t min_digits;
+} UintArg;
+
+static void prv_run_uint(TextBuf *text, const void *arg) {
+  const UintArg *a = arg;
+  prv_fmt_uint(text, a->value, a->min_digits);
+}
+
+static void prv_run_int(TextBuf *text, const void *arg) {
+  prv_fmt_int(text, *(const int32_t *)arg);
+}
+
+typedef struct {
+  int32_t value;
+  uint8_t decimals;
+  const char *suffix;
+} FixedArg;
+
+static void prv_run_fixed(TextBuf *text, const void *arg) {
+  const FixedArg *a = arg;
+  prv_fmt_fixed(text, a->value, a->decimals, a->suffix);
+}
+
+static void prv_run_mmss(TextBuf *text, const void *arg) {
+  prv_fmt_mmss(text, *(const uint32_t *)arg);
+}
+
+static void prv_run_hmmss(TextBuf *text, const void *arg) {
+  prv_fmt_hmmss(text, *(const uint32_t *)arg);
+}
+
+// Several appends in a row, the way the dashboard builds "Z2 0:41:07, Z3 0:12:00".
+static void prv_run_chain(TextBuf *text, const void *arg) {
+  const int32_t *v = arg;
+  prv_fmt_str(text, "Z");
+  prv_fmt_int(text, v[0]);
+  prv_fmt_char(text, ' ');
+  prv_fmt_hmmss(text, (uint32_t)v[1]);
+  prv_fmt_str(text, ", ");
+  prv_fmt_fixed(text, v[2], 2, "km");
+}
+
+int main(void) {
+  char expected[MAX_OUT];
+
+  static const uint32_t uints[] = { 0, 1, 9, 10, 99, 100, 12345, 999999999, 1000000000, UINT32_MAX };
+  for (size_t i = 0; i < sizeof(uints) / sizeof(uints[0]); ++i) {
+    for (uint8_t digits = 0; digits <= 10; ++digits) {
+      UintArg arg = { uints[i], digits };
+      snprintf(expected, sizeof(expected), "%0*" PRIu32, (int)digits, uints[i]);
+      prv_check("uint", prv_run_uint, &arg, expected);
+    }
+  }
+
+  static const int32_t ints[] = { 0, 1, -1, 9, -10, 12345, -12345, INT32_MAX, INT32_MIN, INT32_MIN + 1 };
+  for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i) {
+    snprintf(expected, sizeof(expected), "%" PRId32, ints[i]);
+    prv_check("int", prv_run_int, &ints[i], expected);
+
+    for (uint8_t decimals = 0; decimals <= 3; ++decimals) {
+      static const uint32_t scales[] = { 1, 10, 100, 1000 };
+      FixedArg arg = { ints[i], decimals, decimals == 1 ? "" : "km" };
+      uint32_t magnitude = ints[i] < 0 ? 0u - (uint32_t)ints[i] : (uint32_t)ints[i];
+      if (decimals == 0) {
+        snprintf(expected, sizeof(expected), "%s%" PRIu32 "%s", ints[i] < 0 ? "-" : "", magnitude, arg.suffix);
+      } else {
+        snprintf(expected, sizeof(expected), "%s%" PRIu32 ".%0*" PRIu32 "%s", ints[i] < 0 ? "-" : "",
+                 magnitude / scales[decimals], (int)decimals, magnitude % scales[decimals], arg.suffix);
+      }
+      prv_check("fixed", prv_run_fixed, &arg, expected);
+    }
+  }
+
+  static const uint32_t seconds[] = { 0, 5, 59, 60, 61, 599, 3599, 3600, 3661, 35999, 360000, UINT32_MAX };
+  for (size_t i = 0; i < sizeof(seconds) / sizeof(seconds[0]); ++i) {
+    uint32_t s = seconds[i];
+    snprintf(expected, sizeof(expected), "%" PRIu32 ":%02" PRIu32, s / 60, s % 60);
+    prv_check("mmss", prv_run_mmss, &s, expected);
+    snprintf(expected, sizeof(expected), "%" PRIu32 ":%02" PRIu32 ":%02" PRIu32, s / 3600, (s / 60) % 60, s % 60);
+    prv_check("hmmss", prv_run_hmmss, &s, expected);
+  }
+
+  static const int32_t chains[][3] = { { 2, 2467, 512 }, { 5, 0, -7 }, { INT32_MIN, 359999, INT32_MAX } };
+  for (size_t i = 0; i < sizeof(chains) / sizeof(chains[0]); ++i) {
+    const int32_t *v = chains[i];
+    uint32_t s = (uint32_t)v[1];
+    uint32_t magnitude = v[2] < 0 ? 0u - (uint32_t)v[2] : (uint32_t)v[2];
+    snprintf(expected, sizeof(expected), "Z%" PRId32 " %" PRIu32 ":%02" PRIu32 ":%02" PRIu32 ", %s%" PRIu32 ".%02" PRIu32 "km",
+             v[0], s / 3600, (s / 60) % 60, s % 60, v[2] < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+    prv_check("chain", prv_run_chain, v, expected);
+  }
+
+  printf("%d checks, %d failures\n", s_checks, s_failures);
+  return s_failures ? 1 : 0;
+}
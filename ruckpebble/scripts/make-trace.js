@@ -0,0 +1,18 @@
+#!/usr/bin/env node
+// Regenerates resources/traces/long_ruck.bin from the same generator the phone uses.
+// Usage: node scripts/make-trace.js [hours] [seed]
+var fs = require('fs');
+var path = require('path');
+
+global.Pebble = global.Pebble || {};
+var replay = require('../src/pkjs/replay');
+
+var hours = parseFloat(process.argv[2] || '10');
+var seed = parseInt(process.argv[3] || '1', 10);
+var records = replay.generateLongRuck({ hours: hours, seed: seed });
+var out = path.join(__dirname, '..', 'resources', 'traces', 'long_ruck.bin');
+fs.writeFileSync(out, Buffer.from(replay.encodeTrace(records)));
+
+var seconds = records.reduce(function(sum, r) { return sum + r.duration_s; }, 0);
+var steps = Math.floor(records.reduce(function(sum, r) { return sum + r.cadence_spm * r.duration_s; }, 0) / 60);
+console.log('wrote ' + out + ': ' + records.length + ' records, ' + seconds + ' s, ' + steps + ' steps');
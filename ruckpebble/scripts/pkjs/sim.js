@@ -0,0 +1,475 @@
+#!/usr/bin/env node
+// Runs src/pkjs/index.js under Node with mock Pebble, localStorage and navigator objects and a
+// simulated watch, then reports sync traffic, end-to-end latency and localStorage write volume.
+//
+// Time is virtual and the Bluetooth link is driven by a seeded PRNG, so a given set of options
+// always produces the same report; compare against scripts/pkjs/baseline.json (recorded with the
+// default options) to catch sync or storage regressions without the SDK or emulator.
+//
+// Usage: node scripts/pkjs/sim.js [--iterations N] [--latency-ms MS] [--jitter-ms MS]
+//          [--fail-rate P] [--seed N] [--flows ready,appmessage,config,save]
+//          [--report out.json] [--baseline scripts/pkjs/baseline.json] [--update-baseline] [--verbose]
+var fs = require('fs');
+var path = require('path');
+
+var ROOT = path.join(__dirname, '..', '..');
+var PKJS_DIR = path.join(ROOT, 'src', 'pkjs');
+var WATCH_INBOX_BYTES = 1024;       // app_message_open() sizes in src/c/ruckpebble.c
+var WATCH_OUTBOX_BYTES = 128;
+var WATCH_RETRY_BASE_MS = 500;      // OUTBOX_RETRY_BASE_MS / OUTBOX_MAX_ATTEMPTS on the watch
+var WATCH_MAX_ATTEMPTS = 8;
+var FLOWS = ['ready', 'appmessage', 'config', 'save'];
+
+function parseArgs(argv) {
+  var opts = {
+    iterations: 20,
+    latencyMs: 60,
+    jitterMs: 40,
+    failRate: 0.05,
+    seed: 1,
+    flows: FLOWS.slice(),
+    report: null,
+    baseline: null,
+    updateBaseline: false,
+    verbose: false
+  };
+  for (var i = 2; i < argv.length; ++i) {
+    var arg = argv[i];
+    var next = function() { return argv[++i]; };
+    if (arg === '--iterations') { opts.iterations = parseInt(next(), 10); }
+    else if (arg === '--latency-ms') { opts.latencyMs = parseFloat(next()); }
+    else if (arg === '--jitter-ms') { opts.jitterMs = parseFloat(next()); }
+    else if (arg === '--fail-rate') { opts.failRate = parseFloat(next()); }
+    else if (arg === '--seed') { opts.seed = parseInt(next(), 10); }
+    else if (arg === '--flows') { opts.flows = next().split(','); }
+    else if (arg === '--report') { opts.report = next(); }
+    else if (arg === '--baseline') { opts.baseline = next(); }
+    else if (arg === '--update-baseline') { opts.updateBaseline = true; }
+    else if (arg === '--verbose') { opts.verbose = true; }
+    else { throw new Error('unknown option: ' + arg); }
+  }
+  opts.flows.forEach(function(flow) {
+    if (FLOWS.indexOf(flow) < 0) {
+      throw new Error('unknown flow: ' + flow);
+    }
+  });
+  return opts;
+}
+
+// Mulberry32: small, seedable and good enough for link jitter.
+function makeRandom(seed) {
+  var state = seed >>> 0;
+  return function() {
+    state = (state + 0x6D2B79F5) >>> 0;
+    var t = state;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+// Discrete-event clock shared by the link, the watch and the script's setTimeout calls.
+function makeScheduler() {
+  var queue = [];
+  var sequence = 0;
+  var sched = {
+    now: 0,
+    at: function(delayMs, fn) {
+      queue.push({ time: sched.now + Math.max(0, delayMs), seq: sequence++, fn: fn });
+    },
+    run: function() {
+      while (queue.length) {
+        queue.sort(function(a, b) { return a.time - b.time || a.seq - b.seq; });
+        var event = queue.shift();
+        sched.now = event.time;
+        event.fn();
+      }
+    }
+  };
+  return sched;
+}
+
+function loadMessageKeys() {
+  var pkg = JSON.parse(fs.readFileSync(path.join(ROOT, 'package.json'), 'utf8'));
+  var keys = {};
+  (pkg.pebble.messageKeys || []).forEach(function(name) {
+    keys[name.replace(/\[\d+\]$/, '')] = true;
+  });
+  return keys;
+}
+
+// Serialised AppMessage size: a count byte, then a 7-byte tuple header plus the value per key.
+function dictBytes(dict) {
+  var bytes = 1;
+  Object.keys(dict).forEach(function(key) {
+    var value = dict[key];
+    bytes += 7;
+    if (typeof value === 'number' || typeof value === 'boolean') {
+      bytes += 4;
+    } else if (typeof value === 'string') {
+      bytes += Buffer.byteLength(value, 'utf8') + 1;
+    } else if (Array.isArray(value)) {
+      bytes += value.length;
+    } else {
+      throw new Error('unsupported AppMessage value for ' + key + ': ' + JSON.stringify(value));
+    }
+  });
+  return bytes;
+}
+
+// SessionRecord bytes: version 1, three reserved bytes, then little-endian int32 fields.
+function sessionRecord(fields) {
+  var bytes = [1, 0, 0, 0];
+  fields.forEach(function(value) {
+    bytes.push(value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >>> 24) & 0xFF);
+  });
+  return bytes;
+}
+
+function makeStats() {
+  return {
+    runs: 0,
+    phone_messages: 0,
+    phone_failures: 0,
+    phone_bytes: 0,
+    watch_messages: 0,
+    watch_failures: 0,
+    watch_bytes: 0,
+    storage_writes: 0,
+    storage_bytes: 0,
+    config_page_bytes: 0,
+    latencies_ms: []
+  };
+}
+
+function runSimulation(opts) {
+  var random = makeRandom(opts.seed);
+  var sched = makeScheduler();
+  var messageKeys = loadMessageKeys();
+  var listeners = {};
+  var store = {};
+  var stats = {};
+  var current = null;               // stats bucket of the flow being measured
+  var lastActivity = 0;
+  var phoneQueue = [];
+  var phoneBusy = false;
+
+  // The watch keeps its own totals and answers the way the app does.
+  var watch = {
+    lifetime_distance_m_total: 0,
+    lifetime_calories_total: 0,
+    last_activity_distance_m: 0,
+    last_activity_calories: 0,
+    last_activity_pace_sec: 0,
+    last_activity_timestamp: 0,
+    inbox: []
+  };
+
+  function touch() {
+    lastActivity = sched.now;
+  }
+
+  function linkDelay() {
+    return opts.latencyMs + random() * opts.jitterMs;
+  }
+
+  function emit(name, event) {
+    (listeners[name] || []).forEach(function(fn) {
+      fn(event || {});
+    });
+  }
+
+  function watchReceive(dict) {
+    watch.inbox.push(dict);
+    if (dict.request_lifetime_totals === 1) {
+      watchSend({
+        lifetime_distance_m_total: watch.lifetime_distance_m_total,
+        lifetime_calories_total: watch.lifetime_calories_total,
+        last_activity_distance_m: watch.last_activity_distance_m,
+        last_activity_calories: watch.last_activity_calories,
+        last_activity_pace_sec: watch.last_activity_pace_sec,
+        last_activity_timestamp: watch.last_activity_timestamp
+      }, 0);
+    }
+  }
+
+  // Watch to phone, with the watch outbox's exponential backoff on failure.
+  function watchSend(dict, attempt) {
+    var bytes = dictBytes(dict);
+    if (bytes > WATCH_OUTBOX_BYTES) {
+      throw new Error('watch message of ' + bytes + ' bytes exceeds the ' + WATCH_OUTBOX_BYTES + '-byte outbox');
+    }
+    current.watch_messages++;
+    current.watch_bytes += bytes;
+    sched.at(linkDelay(), function() {
+      touch();
+      if (random() < opts.failRate) {
+        current.watch_failures++;
+        if (attempt + 1 < WATCH_MAX_ATTEMPTS) {
+          sched.at(WATCH_RETRY_BASE_MS << attempt, function() { watchSend(dict, attempt + 1); });
+        }
+        return;
+      }
+      emit('appmessage', { payload: dict });
+    });
+  }
+
+  // Phone to watch. PebbleKit JS sends one message at a time; the rest wait in order.
+  function pumpPhone() {
+    if (phoneBusy || !phoneQueue.length) {
+      return;
+    }
+    phoneBusy = true;
+    var item = phoneQueue.shift();
+    sched.at(linkDelay() * 2, function() {
+      phoneBusy = false;
+      touch();
+      if (random() < opts.failRate) {
+        current.phone_failures++;
+        if (item.fail) {
+          item.fail({ data: { transactionId: 0 }, error: { message: 'simulated NACK' } });
+        }
+      } else {
+        watchReceive(item.dict);
+        if (item.ok) {
+          item.ok({ data: { transactionId: 0 } });
+        }
+      }
+      pumpPhone();
+    });
+  }
+
+  global.Pebble = {
+    addEventListener: function(name, fn) {
+      (listeners[name] = listeners[name] || []).push(fn);
+    },
+    sendAppMessage: function(dict, ok, fail) {
+      Object.keys(dict).forEach(function(key) {
+        if (!messageKeys[key]) {
+          throw new Error('sendAppMessage with key "' + key + '" missing from package.json messageKeys');
+        }
+      });
+      var bytes = dictBytes(dict);
+      if (bytes > WATCH_INBOX_BYTES) {
+        throw new Error('phone message of ' + bytes + ' bytes exceeds the ' + WATCH_INBOX_BYTES + '-byte watch inbox');
+      }
+      current.phone_messages++;
+      current.phone_bytes += bytes;
+      phoneQueue.push({ dict: dict, ok: ok, fail: fail });
+      pumpPhone();
+    },
+    openURL: function(url) {
+      touch();
+      current.config_page_bytes += url.length;
+      current.lastUrl = url;
+    },
+    getActiveWatchInfo: function() {
+      return { platform: 'emery', model: 'pebble_time_2', language: 'en_US', firmware: { major: 4, minor: 4 } };
+    },
+    getAccountToken: function() { return 'sim-account'; },
+    getWatchToken: function() { return 'sim-watch'; }
+  };
+  global.localStorage = {
+    getItem: function(key) {
+      return Object.prototype.hasOwnProperty.call(store, key) ? store[key] : null;
+    },
+    setItem: function(key, value) {
+      var text = String(value);
+      store[key] = text;
+      current.storage_writes++;
+      current.storage_bytes += Buffer.byteLength(key, 'utf8') + Buffer.byteLength(text, 'utf8');
+    },
+    removeItem: function(key) {
+      delete store[key];
+    },
+    clear: function() {
+      store = {};
+    }
+  };
+  global.navigator = {
+    userAgent: 'pkjs-sim',
+    geolocation: {
+      getCurrentPosition: function(ok, fail) {
+        sched.at(linkDelay(), function() {
+          if (fail) {
+            fail({ code: 2, message: 'no position in simulation' });
+          }
+        });
+      }
+    }
+  };
+  global.setTimeout = function(fn, ms) {
+    sched.at(ms || 0, fn);
+    return 0;
+  };
+  if (!opts.verbose) {
+    console.log = function() {};
+  }
+
+  Object.keys(require.cache).forEach(function(id) {
+    if (id.indexOf(PKJS_DIR) === 0) {
+      delete require.cache[id];
+    }
+  });
+  require(path.join(PKJS_DIR, 'index.js'));
+
+  // The config page is not executed; a save is modelled as the page returning the stored
+  // settings with one field changed, the way a user edits a single value.
+  function savedResponse(iteration) {
+    var settings = JSON.parse(global.localStorage.getItem('ruck_settings_v2') || '{}');
+    settings.profile1_ruck_weight_value = 200 + (iteration % 10) * 10;
+    settings.route_updates = [];
+    settings.replay_trace = '';
+    settings.replay_speed = 60;
+    settings.recalculate = 0;
+    return encodeURIComponent(JSON.stringify(settings));
+  }
+
+  var FLOW_STARTERS = {
+    ready: function() {
+      emit('ready');
+    },
+    appmessage: function(iteration) {
+      // A committed session pushes fresh totals.
+      watch.lifetime_distance_m_total += 5000;
+      watch.lifetime_calories_total += 400;
+      watch.last_activity_distance_m = 5000;
+      watch.last_activity_calories = 400;
+      watch.last_activity_pace_sec = 600 + iteration;
+      watch.last_activity_timestamp = 1700000000 + iteration * 86400;
+      watchSend({
+        lifetime_distance_m_total: watch.lifetime_distance_m_total,
+        lifetime_calories_total: watch.lifetime_calories_total,
+        last_activity_distance_m: watch.last_activity_distance_m,
+        last_activity_calories: watch.last_activity_calories,
+        last_activity_pace_sec: watch.last_activity_pace_sec,
+        last_activity_timestamp: watch.last_activity_timestamp
+      }, 0);
+      watchSend({
+        session_record: sessionRecord([watch.last_activity_timestamp - 3000, watch.last_activity_distance_m,
+          watch.last_activity_calories, watch.last_activity_pace_sec, 3000])
+      }, 0);
+    },
+    config: function() {
+      emit('showConfiguration');
+    },
+    save: function(iteration) {
+      emit('webviewclosed', { response: savedResponse(iteration) });
+    }
+  };
+
+  // Flows run one after another; a flow ends when the link and timers go quiet, and its latency is
+  // the time from the triggering event to the last message, callback or page open it caused.
+  for (var iteration = 0; iteration < opts.iterations; ++iteration) {
+    opts.flows.forEach(function(flow) {
+      current = stats[flow] = stats[flow] || makeStats();
+      var start = sched.now;
+      lastActivity = start;
+      FLOW_STARTERS[flow](iteration);
+      sched.run();
+      current.runs++;
+      current.latencies_ms.push(lastActivity - start);
+    });
+  }
+  return stats;
+}
+
+function percentile(values, pct) {
+  if (!values.length) {
+    return null;
+  }
+  var ordered = values.slice().sort(function(a, b) { return a - b; });
+  return ordered[Math.min(ordered.length - 1, Math.round((pct / 100) * (ordered.length - 1)))];
+}
+
+function round(value) {
+  return value === null ? null : Math.round(value * 10) / 10;
+}
+
+function summarise(stats) {
+  var out = {};
+  Object.keys(stats).forEach(function(flow) {
+    var s = stats[flow];
+    var latencies = s.latencies_ms;
+    out[flow] = {
+      runs: s.runs,
+      phone_messages: s.phone_messages,
+      phone_failures: s.phone_failures,
+      phone_bytes: s.phone_bytes,
+      watch_messages: s.watch_messages,
+      watch_failures: s.watch_failures,
+      watch_bytes: s.watch_bytes,
+      storage_writes: s.storage_writes,
+      storage_bytes: s.storage_bytes,
+      config_page_bytes: s.config_page_bytes,
+      latency_mean_ms: round(latencies.reduce(function(a, b) { return a + b; }, 0) / latencies.length),
+      latency_p95_ms: round(percentile(latencies, 95)),
+      latency_max_ms: round(Math.max.apply(null, latencies))
+    };
+  });
+  return out;
+}
+
+function printSummary(summary, opts, write) {
+  write('pkjs sync simulation: ' + opts.iterations + ' iterations, latency ' + opts.latencyMs + '+' +
+        opts.jitterMs + ' ms, fail rate ' + opts.failRate + ', seed ' + opts.seed);
+  var columns = ['runs', 'phone_messages', 'phone_failures', 'phone_bytes', 'watch_messages', 'watch_bytes',
+                 'storage_writes', 'storage_bytes', 'config_page_bytes', 'latency_mean_ms', 'latency_p95_ms',
+                 'latency_max_ms'];
+  Object.keys(summary).forEach(function(flow) {
+    write(flow);
+    columns.forEach(function(column) {
+      write('  ' + (column + '                  ').slice(0, 18) + summary[flow][column]);
+    });
+  });
+}
+
+// A metric regresses when it exceeds baseline * (1 + tolerance) + slack; null baselines are
+// reported but never fail.
+function compareBaseline(summary, baselinePath, update, write) {
+  var baseline = JSON.parse(fs.readFileSync(baselinePath, 'utf8'));
+  var failed = false;
+  Object.keys(baseline.metrics).sort().forEach(function(name) {
+    var spec = baseline.metrics[name];
+    var parts = name.split('.');
+    var value = summary[parts[0]] ? summary[parts[0]][parts[1]] : undefined;
+    if (update) {
+      spec.value = value === undefined ? null : value;
+      return;
+    }
+    var status;
+    var limit = null;
+    if (value === undefined) {
+      status = 'MISSING';
+      failed = true;
+    } else if (spec.value === null) {
+      status = 'no baseline';
+    } else {
+      limit = spec.value * (1 + (spec.tolerance || 0)) + (spec.slack || 0);
+      status = value > limit ? 'REGRESSED' : 'ok';
+      failed = failed || value > limit;
+    }
+    write(('  ' + name + '                              ').slice(0, 32) + spec.value + ' -> ' + value +
+          (limit === null ? '' : ' (limit ' + round(limit) + ')') + '  ' + status);
+  });
+  if (update) {
+    fs.writeFileSync(baselinePath, JSON.stringify(baseline, null, 2) + '\n');
+    write('baseline updated: ' + baselinePath);
+  }
+  return failed;
+}
+
+function main() {
+  var opts = parseArgs(process.argv);
+  var write = console.log.bind(console);
+  var summary = summarise(runSimulation(opts));
+  printSummary(summary, opts, write);
+  if (opts.report) {
+    fs.writeFileSync(opts.report, JSON.stringify(summary, null, 2) + '\n');
+  }
+  if (opts.baseline && compareBaseline(summary, opts.baseline, opts.updateBaseline, write)) {
+    process.exitCode = 1;
+  }
+}
+
+main();
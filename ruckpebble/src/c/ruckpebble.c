@@ -1,6 +1,7 @@
 #include <pebble.h>
 #include <stdlib.h>
 #include <string.h>
+#include "text_fmt.h"
 
 #ifndef MESSAGE_KEY_sim_steps_enabled
 #define MESSAGE_KEY_sim_steps_enabled 8
@@ -38,6 +39,99 @@
 #ifndef MESSAGE_KEY_last_activity_timestamp
 #define MESSAGE_KEY_last_activity_timestamp 0x7FFFFFE3
 #endif
+#ifndef MESSAGE_KEY_profile1_energy_model
+#define MESSAGE_KEY_profile1_energy_model 0x7FFFFFD0
+#endif
+#ifndef MESSAGE_KEY_profile2_energy_model
+#define MESSAGE_KEY_profile2_energy_model 0x7FFFFFD1
+#endif
+#ifndef MESSAGE_KEY_profile3_energy_model
+#define MESSAGE_KEY_profile3_energy_model 0x7FFFFFD2
+#endif
+#ifndef MESSAGE_KEY_age_years
+#define MESSAGE_KEY_age_years 0x7FFFFFD3
+#endif
+#ifndef MESSAGE_KEY_sex
+#define MESSAGE_KEY_sex 0x7FFFFFD4
+#endif
+#ifndef MESSAGE_KEY_auto_pause_seconds
+#define MESSAGE_KEY_auto_pause_seconds 0x7FFFFFD9
+#endif
+#ifndef MESSAGE_KEY_workout_program
+#define MESSAGE_KEY_workout_program 0x7FFFFFDA
+#endif
+#ifndef MESSAGE_KEY_planned_duration_min
+#define MESSAGE_KEY_planned_duration_min 0x7FFFFFDB
+#endif
+#ifndef MESSAGE_KEY_route_profile
+#define MESSAGE_KEY_route_profile 0x7FFFFFDC
+#endif
+#ifndef MESSAGE_KEY_route_segments
+#define MESSAGE_KEY_route_segments 0x7FFFFFDD
+#endif
+#ifndef MESSAGE_KEY_step_source
+#define MESSAGE_KEY_step_source 0x7FFFFFDE
+#endif
+#ifndef MESSAGE_KEY_accel_threshold_mg
+#define MESSAGE_KEY_accel_threshold_mg 0x7FFFFFDF
+#endif
+#ifndef MESSAGE_KEY_accel_min_step_ms
+#define MESSAGE_KEY_accel_min_step_ms 0x7FFFFFE4
+#endif
+#ifndef MESSAGE_KEY_recalculate
+#define MESSAGE_KEY_recalculate 0x7FFFFFE5
+#endif
+#ifndef MESSAGE_KEY_display_wake_s
+#define MESSAGE_KEY_display_wake_s 0x7FFFFFE6
+#endif
+#ifndef MESSAGE_KEY_session_histograms
+#define MESSAGE_KEY_session_histograms 0x7FFFFFED
+#endif
+#ifndef MESSAGE_KEY_ghost_mode
+#define MESSAGE_KEY_ghost_mode 0x7FFFFFEE
+#endif
+#ifndef MESSAGE_KEY_stride_profile
+#define MESSAGE_KEY_stride_profile 0x7FFFFFEF
+#endif
+#ifndef MESSAGE_KEY_stride_table
+#define MESSAGE_KEY_stride_table 0x7FFFFFF6
+#endif
+#ifndef MESSAGE_KEY_stride_calibration
+#define MESSAGE_KEY_stride_calibration 0x7FFFFFF7
+#endif
+#ifndef MESSAGE_KEY_session_record
+#define MESSAGE_KEY_session_record 0x7FFFFFF8
+#endif
+#ifndef MESSAGE_KEY_profile1_pacer_spm
+#define MESSAGE_KEY_profile1_pacer_spm 0x7FFFFFE7
+#endif
+#ifndef MESSAGE_KEY_profile1_pacer_pace_s
+#define MESSAGE_KEY_profile1_pacer_pace_s 0x7FFFFFE8
+#endif
+#ifndef MESSAGE_KEY_profile2_pacer_spm
+#define MESSAGE_KEY_profile2_pacer_spm 0x7FFFFFE9
+#endif
+#ifndef MESSAGE_KEY_profile2_pacer_pace_s
+#define MESSAGE_KEY_profile2_pacer_pace_s 0x7FFFFFEA
+#endif
+#ifndef MESSAGE_KEY_profile3_pacer_spm
+#define MESSAGE_KEY_profile3_pacer_spm 0x7FFFFFEB
+#endif
+#ifndef MESSAGE_KEY_profile3_pacer_pace_s
+#define MESSAGE_KEY_profile3_pacer_pace_s 0x7FFFFFEC
+#endif
+#ifndef MESSAGE_KEY_replay_start
+#define MESSAGE_KEY_replay_start 0x7FFFFFD5
+#endif
+#ifndef MESSAGE_KEY_replay_speed
+#define MESSAGE_KEY_replay_speed 0x7FFFFFD6
+#endif
+#ifndef MESSAGE_KEY_replay_trace_offset
+#define MESSAGE_KEY_replay_trace_offset 0x7FFFFFD7
+#endif
+#ifndef MESSAGE_KEY_replay_trace_chunk
+#define MESSAGE_KEY_replay_trace_chunk 0x7FFFFFD8
+#endif
 
 #define PROFILE_COUNT 3
 #define PROFILE_NAME_MAX_LEN 33
@@ -47,6 +141,38 @@
 #define PROFILE_ROW_SEPARATOR_HEIGHT 1
 #define PROFILE_GRADE_TEXT_WIDTH 24
 #define PROFILE_TERRAIN_BONUS_WIDTH 8
+#define ICON_CACHE_SLOTS 8
+#define ROLLUP_WEEKS 8
+#define ROLLUP_MONTHS 4
+#define ROLLUPS_VERSION 1
+#define WORKOUT_MAX_INSTR 40
+#define WORKOUT_PACE_CHECK_S 30
+#define WORKOUT_PACE_TOLERANCE_PCT 8
+#define ICON_CACHE_LOW_HEAP_BYTES 4096
+#define SESSION_CHECKPOINT_VERSION 5
+#define ROUTE_MAX_SEGMENTS 60
+#define OUTBOX_RETRY_BASE_MS 500
+#define OUTBOX_RETRY_MAX_MS 60000
+#define OUTBOX_MAX_ATTEMPTS 8
+#define ACCEL_BATCH_SAMPLES 25
+#define ACCEL_GRAVITY_SHIFT 5
+#define ACCEL_LOWPASS_SHIFT 1
+#define ACCEL_MAX_STEP_INTERVAL_MS 2000
+#define SESSION_CHECKPOINT_MAX_GAP_S (12 * 60 * 60)
+#define SESSION_MAX_SEGMENTS 6
+#define SESSION_SAMPLE_CAPACITY 240
+#define SESSION_SAMPLE_BASE_INTERVAL_S 5
+#define SESSION_HISTORY_VERSION 1
+#define SESSION_HISTORY_PERSIST_KEYS 4
+#define HISTORY_COLUMNS 180
+#define HISTORY_PACE_UNIT_S 8
+#define HISTORY_MIN_SPEED_MMPS 500
+#define RECALC_SAVED_INTERVALS 48
+#define RECALC_SLICE_SAMPLES 24
+#define RECALC_SLICE_MS 50
+#define SAVED_SERIES_VERSION 2
+#define SAVED_SERIES_PERSIST_KEYS 2
+#define RECALC_JOURNAL_VERSION 2
 
 typedef struct {
   int32_t ruck_weight_value;  // tenths
@@ -68,6 +194,30 @@ typedef struct {
   char profile_terrain_types[PROFILE_COUNT][TERRAIN_TYPE_MAX_LEN];
 } Settings;
 
+typedef enum {
+  ENERGY_MODEL_PANDOLF = 0,  // Pandolf with Santee downhill correction
+  ENERGY_MODEL_LCDA = 1,     // Looney load carriage decision aid
+  ENERGY_MODEL_KEYTEL = 2,   // Keytel heart-rate estimate
+  ENERGY_MODEL_COUNT
+} EnergyModelId;
+
+// Settings added after the original record; kept in their own persist key because Settings is
+// already close to PERSIST_DATA_MAX_LENGTH. Append new fields at the end only.
+typedef struct {
+  int32_t profile_energy_models[PROFILE_COUNT];  // EnergyModelId
+  int32_t age_years;
+  int32_t sex;                // 0=male, 1=female
+  int32_t auto_pause_seconds; // 0 = off
+  int32_t planned_duration_min; // 0 = unknown
+  int32_t step_source;        // StepSource
+  int32_t accel_threshold_mg; // minimum step peak height
+  int32_t accel_min_step_ms;  // refractory window between steps
+  int32_t display_wake_s;     // live display after a tap, 0 = always live
+  int32_t profile_pacer_spm[PROFILE_COUNT];     // metronome cadence, 0 = off
+  int32_t profile_pacer_pace_s[PROFILE_COUNT];  // pace band centre, s per km, 0 = off
+  int32_t ghost_mode;         // GhostMode
+} ExtendedSettings;
+
 enum {
   SETTINGS_PERSIST_KEY = 1,
   LIFETIME_DISTANCE_M_PERSIST_KEY = 2,
@@ -75,7 +225,20 @@ enum {
   LAST_ACTIVITY_DISTANCE_M_PERSIST_KEY = 4,
   LAST_ACTIVITY_CALORIES_PERSIST_KEY   = 5,
   LAST_ACTIVITY_PACE_SEC_PERSIST_KEY   = 6,
-  LAST_ACTIVITY_TIMESTAMP_PERSIST_KEY  = 7
+  LAST_ACTIVITY_TIMESTAMP_PERSIST_KEY  = 7,
+  EXTENDED_SETTINGS_PERSIST_KEY        = 8,
+  GLANCE_SIGNATURE_PERSIST_KEY         = 9,
+  ROLLUPS_PERSIST_KEY                  = 10,
+  WORKOUT_PERSIST_KEY                  = 11,
+  SESSION_CHECKPOINT_PERSIST_KEY       = 12,
+  ROUTE_PROFILE1_PERSIST_KEY           = 13,  // 13..15, one per profile
+  SESSION_HISTORY_FIRST_PERSIST_KEY    = 16,  // 16..19, chunked SessionHistory
+  SAVED_SERIES_FIRST_PERSIST_KEY       = 20,  // 20..21, chunked SavedSessionSeries
+  RECALC_JOURNAL_PERSIST_KEY           = 22,
+  SESSION_HISTOGRAMS_PERSIST_KEY       = 23,  // running session, alongside the checkpoint
+  LAST_HISTOGRAMS_PERSIST_KEY          = 24,
+  GHOST_PROFILE1_PERSIST_KEY           = 25,  // 25..27, one reference table per profile
+  STRIDE_TABLES_PERSIST_KEY            = 28,
 };
 
 static const Settings SETTINGS_DEFAULTS = {
@@ -104,10 +267,29 @@ static const Settings SETTINGS_DEFAULTS = {
   }
 };
 
+static const ExtendedSettings EXTENDED_SETTINGS_DEFAULTS = {
+  .profile_energy_models = { ENERGY_MODEL_PANDOLF, ENERGY_MODEL_PANDOLF, ENERGY_MODEL_PANDOLF },
+  .age_years = 35,
+  .sex = 0,
+  .auto_pause_seconds = 60,
+  .planned_duration_min = 0,
+  .step_source = 0,
+  .accel_threshold_mg = 90,
+  .accel_min_step_ms = 280,
+  .display_wake_s = 0,
+  .profile_pacer_spm = { 0, 0, 0 },
+  .profile_pacer_pace_s = { 0, 0, 0 },
+  .ghost_mode = 0
+};
+
 static Window *s_profile_window;
 static MenuLayer *s_profile_menu_layer;
 static Window *s_music_window;
 static MenuLayer *s_music_menu_layer;
+static Window *s_stats_window;
+static MenuLayer *s_stats_menu_layer;
+static Window *s_history_window;
+static Layer *s_history_layer;
 static Window *s_status_window;
 static TextLayer *s_status_text_layer;
 static AppTimer *s_status_timer;
@@ -140,12 +322,13 @@ static GBitmap *s_profile_grade_icon;
 static int16_t s_profile_cell_height = PROFILE_ROW_HEIGHT;
 
 static Settings s_settings;
+static ExtendedSettings s_ext_settings;
 static time_t s_start_time;
 static bool s_health_available = false;
 static time_t s_day_start;
 static int32_t s_steps_baseline = 0;
 static int32_t s_last_steps = 0;
-static time_t s_last_time = 0;
+static int64_t s_speed_window_ms = -1;   // active ms at the start of the speed window, -1 = unset
 static int64_t s_speed_mmps = 0;
 static int32_t s_session_distance_m = 0;
 static int32_t s_session_calories = 0;
@@ -157,8 +340,97 @@ static int32_t s_last_activity_calories   = 0;
 static int32_t s_last_activity_pace_sec   = 0;
 static int32_t s_last_activity_timestamp  = 0;
 static int32_t s_session_pace_sec         = 0;
+static int64_t s_energy_last_ms = 0;     // active ms integrated into the energy totals so far
+static int64_t s_session_energy_mj = 0;      // integral of model power, mW * s
+static int64_t s_session_walk_kcal_s = 0;    // integral of ACSM kcal/h, kcal/h * s
+static bool s_paused = false;
+static bool s_pause_manual = false;
+static int32_t s_motion_last_steps = 0;
+static int64_t s_motion_last_ms = 0;     // active ms of the last step change
+static TimeUnits s_tick_units = 0;
 
 #define EMULATOR_TIME_SCALE 10
+#define REPLAY_SLICE_MS 100
+#define REPLAY_MAX_RECORDS 256
+
+// --- Session clock ---------------------------------------------------------------------------
+// Every session computation reads time here, in milliseconds. The timeline comes from an
+// injectable source (the wall clock, or the replay engine's virtual time) and stays continuous
+// when the source changes. Active time excludes pauses and has the time scale applied; pause,
+// resume and scale changes bank the active time so far, so intervals stay exact and never drift.
+
+typedef int64_t (*ClockSourceFn)(void);
+
+typedef struct {
+  ClockSourceFn source;
+  int64_t source_offset_ms;   // keeps the timeline monotonic across source switches
+  uint32_t scale;             // active ms per timeline ms
+  bool paused;
+  int64_t active_base_ms;     // active time banked at the last rebase
+  int64_t rebased_at_ms;      // timeline ms of the last rebase
+} SessionClock;
+
+static int64_t prv_clock_wall_ms(void) {
+  time_t seconds = 0;
+  uint16_t millis = time_ms(&seconds, NULL);
+  return (int64_t)seconds * 1000 + millis;
+}
+
+static SessionClock s_clock = {
+  .source = prv_clock_wall_ms,
+  .scale = 1,
+};
+
+static int64_t prv_clock_now_ms(void) {
+  return s_clock.source() + s_clock.source_offset_ms;
+}
+
+static time_t prv_session_now(void) {
+  return (time_t)(prv_clock_now_ms() / 1000);
+}
+
+static int64_t prv_clock_active_ms(void) {
+  if (s_clock.paused) {
+    return s_clock.active_base_ms;
+  }
+  return s_clock.active_base_ms + (prv_clock_now_ms() - s_clock.rebased_at_ms) * s_clock.scale;
+}
+
+static void prv_clock_rebase(void) {
+  s_clock.active_base_ms = prv_clock_active_ms();
+  s_clock.rebased_at_ms = prv_clock_now_ms();
+}
+
+static void prv_clock_set_source(ClockSourceFn source) {
+  int64_t now_ms = prv_clock_now_ms();
+  prv_clock_rebase();
+  s_clock.source = source ? source : prv_clock_wall_ms;
+  s_clock.source_offset_ms = now_ms - s_clock.source();
+}
+
+static void prv_clock_set_scale(uint32_t scale) {
+  if (scale == s_clock.scale) {
+    return;
+  }
+  prv_clock_rebase();
+  s_clock.scale = scale > 0 ? scale : 1;
+}
+
+static void prv_clock_set_paused(bool paused) {
+  prv_clock_rebase();
+  s_clock.paused = paused;
+}
+
+// Starts active time at active_ms from now; a wall-clock session also drops any offset left by
+// an earlier replay.
+static void prv_clock_start(int64_t active_ms, bool paused) {
+  if (s_clock.source == prv_clock_wall_ms) {
+    s_clock.source_offset_ms = 0;
+  }
+  s_clock.active_base_ms = active_ms;
+  s_clock.rebased_at_ms = prv_clock_now_ms();
+  s_clock.paused = paused;
+}
 
 static int64_t prv_weight_to_kg1000(int32_t value_tenths, int32_t unit) {
   if (unit == 1) {
@@ -264,10 +536,48 @@ static const char *prv_profile_display_name(int32_t row, char *fallback, size_t
   if (row == 1) {
     return "One Mabel, roads and tracks";
   }
-  snprintf(fallback, fallback_size, "Profile %ld", (long)(row + 1));
+  TextBuf text = prv_fmt_begin(fallback, fallback_size);
+  prv_fmt_str(&text, "Profile ");
+  prv_fmt_int(&text, row + 1);
   return fallback;
 }
 
+// Profile menu row text only changes with settings, so it is formatted once here rather than in
+// the draw callback.
+typedef struct {
+  char title[PROFILE_NAME_MAX_LEN];
+  char weight[12];
+  char terrain[12];
+  char grade[8];
+} ProfileRowModel;
+
+static ProfileRowModel s_profile_rows[PROFILE_COUNT];
+
+static void prv_profile_rows_rebuild(void) {
+  const char *weight_unit = (s_settings.ruck_weight_unit == 1) ? "lb" : "kg";
+  for (int row = 0; row < PROFILE_COUNT; ++row) {
+    ProfileRowModel *model = &s_profile_rows[row];
+    ProfileSettings *p = &s_settings.profiles[row];
+    const char *title = prv_profile_display_name(row, model->title, sizeof(model->title));
+    if (title != model->title) {
+      strncpy(model->title, title, sizeof(model->title) - 1);
+      model->title[sizeof(model->title) - 1] = '\0';
+    }
+    TextBuf text = prv_fmt_begin(model->weight, sizeof(model->weight));
+    prv_fmt_fixed(&text, p->ruck_weight_value, 1, weight_unit);
+    text = prv_fmt_begin(model->terrain, sizeof(model->terrain));
+    prv_fmt_str(&text, prv_profile_terrain_label(row, p->terrain_factor));
+    int32_t grade_int = (p->grade_percent >= 0) ? ((p->grade_percent + 5) / 10) : ((p->grade_percent - 5) / 10);
+    text = prv_fmt_begin(model->grade, sizeof(model->grade));
+    if (persist_exists(ROUTE_PROFILE1_PERSIST_KEY + row)) {
+      prv_fmt_str(&text, "GPX");
+    } else {
+      prv_fmt_int(&text, grade_int);
+      prv_fmt_char(&text, '%');
+    }
+  }
+}
+
 static ProfileSettings *prv_active_profile(void) {
   return &s_settings.profiles[prv_active_profile_index()];
 }
@@ -276,6 +586,91 @@ static int64_t prv_grade_q(void) {
   return (int64_t)prv_active_profile()->grade_percent * 10;
 }
 
+// Route grade profile: distance-ordered segments imported from GPX on the phone, one table per
+// profile in its own persist key. Only the active profile's table is held in RAM. Lookups walk a
+// forward-only cursor, so each tick costs O(1) amortised; past the end of the route the profile's
+// fixed grade applies again.
+typedef struct {
+  uint16_t length_m;
+  int16_t grade_tenths;     // tenths of percent, same scale as ProfileSettings.grade_percent
+} RouteSegment;
+
+typedef struct {
+  RouteSegment segments[ROUTE_MAX_SEGMENTS];
+  uint8_t count;
+  int8_t profile;           // profile whose table is loaded, -1 = none
+  uint8_t cursor;
+  int32_t cursor_start_m;   // route distance at the start of segments[cursor]
+  int32_t total_m;
+} RouteProfile;
+
+static RouteProfile s_route = { .profile = -1 };
+
+static uint32_t prv_route_persist_key(int32_t profile_index) {
+  return ROUTE_PROFILE1_PERSIST_KEY + (uint32_t)profile_index;
+}
+
+static void prv_route_rewind(void) {
+  s_route.cursor = 0;
+  s_route.cursor_start_m = 0;
+}
+
+static void prv_route_load(int32_t profile_index) {
+  s_route.count = 0;
+  s_route.total_m = 0;
+  s_route.profile = (int8_t)profile_index;
+  prv_route_rewind();
+  uint32_t key = prv_route_persist_key(profile_index);
+  if (persist_exists(key)) {
+    int read = persist_read_data(key, s_route.segments, sizeof(s_route.segments));
+    s_route.count = read > 0 ? (uint8_t)(read / sizeof(RouteSegment)) : 0;
+  }
+  for (uint8_t i = 0; i < s_route.count; ++i) {
+    s_route.total_m += s_route.segments[i].length_m;
+  }
+  if (s_route.count > 0) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Route loaded for profile %ld: %u segments, %ld m",
+            (long)(profile_index + 1), (unsigned)s_route.count, (long)s_route.total_m);
+  }
+}
+
+static void prv_route_store(int32_t profile_index, const uint8_t *data, uint16_t length) {
+  if (profile_index < 0 || profile_index >= PROFILE_COUNT) {
+    return;
+  }
+  uint16_t count = length / sizeof(RouteSegment);
+  if (count > ROUTE_MAX_SEGMENTS) {
+    count = ROUTE_MAX_SEGMENTS;
+  }
+  uint32_t key = prv_route_persist_key(profile_index);
+  if (count == 0) {
+    persist_delete(key);
+  } else {
+    persist_write_data(key, data, count * sizeof(RouteSegment));
+  }
+  if (profile_index == s_route.profile) {
+    prv_route_load(profile_index);
+  }
+}
+
+// grade_q for the given session distance. Moving backwards (a new session) rewinds the cursor.
+static int64_t prv_route_grade_q(int64_t distance_m) {
+  if (s_route.profile != prv_active_profile_index()) {
+    prv_route_load(prv_active_profile_index());
+  }
+  if (s_route.count == 0 || distance_m >= s_route.total_m) {
+    return prv_grade_q();
+  }
+  if (distance_m < s_route.cursor_start_m) {
+    prv_route_rewind();
+  }
+  while (distance_m >= s_route.cursor_start_m + s_route.segments[s_route.cursor].length_m) {
+    s_route.cursor_start_m += s_route.segments[s_route.cursor].length_m;
+    s_route.cursor++;
+  }
+  return (int64_t)s_route.segments[s_route.cursor].grade_tenths * 10;
+}
+
 static int64_t prv_isqrt(int64_t x) {
   int64_t op = x;
   int64_t res = 0;
@@ -296,47 +691,200 @@ static int64_t prv_isqrt(int64_t x) {
   return res;
 }
 
-static int64_t prv_pandolf_metabolic_mw(int64_t weight_kg1000, int64_t load_kg1000, int64_t speed_mmps) {
-  if (weight_kg1000 <= 0) {
-    return 0;
+// Per-profile constants for the energy models. Everything that does not depend on speed, grade or
+// heart rate is folded in here once so the per-tick evaluators stay constant-time kernels.
+typedef struct {
+  int64_t weight_kg1000;
+  int64_t total_kg1000;        // body + load
+  int64_t ratio_q;             // load / body, scale 1e6
+  int64_t total_over_weight_q; // (body + load) / body, scale 1e6
+  int64_t terrain_q;           // scale 1e2
+  int64_t pandolf_standing_mw; // 1.5W + 2(W+L)(L/W)^2
+  int64_t pandolf_total_mu;    // (W+L) * terrain, kg1000
+  int64_t lcda_standing_mw;    // 1.44 W/kg * (W+L)
+  int64_t keytel_base_q4;      // Keytel intercept incl. body weight and age terms, kJ/min * 1e4
+  int64_t keytel_hr_q4;        // Keytel heart-rate slope, kJ/min/bpm * 1e4
+} EnergyModelParams;
+
+// Returns metabolic power in mW. grade_q is percent * 100 (same scale as prv_grade_q()).
+typedef int64_t (*EnergyModelEvalFn)(const EnergyModelParams *params, int64_t speed_mmps,
+                                     int64_t grade_q, int32_t heart_rate_bpm);
+
+typedef struct {
+  const char *name;
+  EnergyModelEvalFn evaluate;
+} EnergyModel;
+
+// LCDA speed term S^0.43 sampled every 0.125 m/s from 0 to 5 m/s, Q1000.
+#define LCDA_SPEED_STEP_MMPS 125
+static const int16_t LCDA_SPEED_POW_Q[] = {
+  0, 409, 551, 656, 742, 817, 884, 944, 1000, 1052, 1101, 1147, 1190, 1232,
+  1272, 1310, 1347, 1383, 1417, 1451, 1483, 1514, 1545, 1575, 1604, 1632, 1660,
+  1687, 1714, 1740, 1765, 1790, 1815, 1839, 1863, 1886, 1909, 1932, 1954, 1976, 1998
+};
+
+// LCDA grade attenuation 1 - 1.05^(1 - 1.1^(G + 32)) sampled every 2% from -32% to +16%, Q1000.
+#define LCDA_GRADE_MIN_Q (-3200)
+#define LCDA_GRADE_STEP_Q 200
+static const int16_t LCDA_GRADE_ATTEN_Q[] = {
+  0, 10, 22, 37, 54, 75, 99, 128, 161, 199, 244, 294, 351,
+  413, 480, 552, 625, 698, 768, 831, 885, 927, 959, 979, 991
+};
+
+static int64_t prv_table_lerp(const int16_t *table, int32_t count, int64_t x, int64_t x0, int64_t step) {
+  if (x <= x0) {
+    return table[0];
+  }
+  int64_t offset = x - x0;
+  int64_t index = offset / step;
+  if (index >= count - 1) {
+    return table[count - 1];
   }
-  int64_t total = weight_kg1000 + load_kg1000;
-  int64_t ratio_q = (load_kg1000 * 1000000) / weight_kg1000;
-  int64_t ratio_sq_q = (ratio_q * ratio_q) / 1000000;
-  int64_t term1 = (weight_kg1000 * 3) / 2;
-  int64_t term2 = (2 * total * ratio_sq_q) / 1000000;
+  int64_t frac = offset % step;
+  return table[index] + ((table[index + 1] - table[index]) * frac) / step;
+}
 
+static int64_t prv_energy_pandolf_mw(const EnergyModelParams *params, int64_t speed_mmps,
+                                     int64_t grade_q, int32_t heart_rate_bpm) {
+  (void)heart_rate_bpm;
+  if (params->weight_kg1000 <= 0) {
+    return 0;
+  }
   int64_t v_q = speed_mmps;          // m/s * 1000
   int64_t v2_q = v_q * v_q;          // scale 1e6
   int64_t termA_q = (v2_q * 3) / 2;  // scale 1e6
-  int64_t G_q = prv_grade_q();       // scale 1e4
-  int64_t termB_q = v_q * G_q;       // scale 1e7
-  termB_q = (termB_q * 35) / 100;    // scale 1e7
-  termB_q = termB_q / 10;            // scale 1e6
+  // Textbook grade term 0.35 V G with G in percent on both sides of level, so the slope is
+  // continuous through 0 % and Santee's downhill correction below applies to the term it was
+  // calibrated against.
+  int64_t termB_q = (v_q * grade_q * 35) / 10;  // scale 1e6
   int64_t inner_q = termA_q + termB_q;
-  int64_t mu_q = prv_active_profile()->terrain_factor; // scale 1e2
-  int64_t term3_base = (total * inner_q * mu_q) / (100 * 1000000);
+  int64_t term3_base = (params->pandolf_total_mu * inner_q) / 1000000;
 
   int64_t v2_03_q = (v2_q * 3) / 10;           // scale 1e6
   int64_t sqrt_03_v2_q = prv_isqrt(v2_03_q);   // scale 1e3
   int64_t sqrt_term_q = (sqrt_03_v2_q * 1000) / 7; // scale 1e6
 
-  int64_t v_lr_q = (v_q * ratio_q) / 1000000;  // scale 1e3
-  int64_t vl_term_q = (v_lr_q * v_lr_q) / 4;   // scale 1e6
+  int64_t v_lr_q = (v_q * params->ratio_q) / 1000000;  // scale 1e3
+  int64_t vl_term_q = (v_lr_q * v_lr_q) / 4;           // scale 1e6
 
   int64_t mult_base_q = 1000000 + sqrt_term_q + vl_term_q;
   int64_t mult_q = (mult_base_q * 11) / 10;    // scale 1e6
   int64_t term3 = (term3_base * mult_q) / 1000000;
-  (void)mult_q;
+  int64_t total_mw = params->pandolf_standing_mw + term3;
+
+  if (grade_q < 0) {
+    // Santee downhill correction, G in percent:
+    // CF = mu * [G(W+L)V/3.5 - (W+L)(G+6)^2/W + (25 - V^2)], M = Pandolf - CF.
+    int64_t cf_grade_mw = (grade_q * params->total_kg1000 * v_q) / 350000;
+    int64_t g6_q = grade_q + 600;
+    int64_t cf_mass_mw = (params->total_over_weight_q * g6_q * g6_q) / 10000000;
+    int64_t cf_speed_mw = 25000 - (v2_q / 1000);
+    int64_t cf_mw = (params->terrain_q * (cf_grade_mw - cf_mass_mw + cf_speed_mw)) / 100;
+    total_mw -= cf_mw;
+    if (total_mw < params->pandolf_standing_mw) {
+      total_mw = params->pandolf_standing_mw;
+    }
+  }
+  return total_mw;
+}
+
+// LCDA (Looney et al.) load carriage equation, per kg of body + load:
+// 1.44 + 1.94 S^0.43 + 0.24 S^4 + 0.34 S G (1 - 1.05^(1 - 1.1^(G + 32))).
+// The terrain factor scales the locomotion terms the same way Pandolf's mu does.
+static int64_t prv_energy_lcda_mw(const EnergyModelParams *params, int64_t speed_mmps,
+                                  int64_t grade_q, int32_t heart_rate_bpm) {
+  (void)heart_rate_bpm;
+  int64_t total = params->total_kg1000;
+  int64_t v_q = speed_mmps;
+  int64_t speed_pow_q = prv_table_lerp(LCDA_SPEED_POW_Q, ARRAY_LENGTH(LCDA_SPEED_POW_Q),
+                                       v_q, 0, LCDA_SPEED_STEP_MMPS);       // scale 1e3
+  int64_t v2_q = (v_q * v_q) / 1000;                                        // scale 1e3
+  int64_t v4_q = (v2_q * v2_q) / 1000;                                      // scale 1e3
+  int64_t speed_mw = (total * 194 * speed_pow_q) / 100000 + (total * 24 * v4_q) / 100000;
+
+  int64_t atten_q = prv_table_lerp(LCDA_GRADE_ATTEN_Q, ARRAY_LENGTH(LCDA_GRADE_ATTEN_Q),
+                                   grade_q, LCDA_GRADE_MIN_Q, LCDA_GRADE_STEP_Q);  // scale 1e3
+  int64_t grade_mw = (total * 34 * v_q / 100000) * grade_q * atten_q / 100000;
+
+  int64_t total_mw = params->lcda_standing_mw + ((speed_mw + grade_mw) * params->terrain_q) / 100;
+  if (total_mw < params->lcda_standing_mw) {
+    total_mw = params->lcda_standing_mw;
+  }
+  return total_mw;
+}
+
+// Keytel et al. (2005) heart-rate estimate without VO2max. Falls back to Pandolf while no HR
+// reading is available so the energy integral never stalls.
+static int64_t prv_energy_keytel_mw(const EnergyModelParams *params, int64_t speed_mmps,
+                                    int64_t grade_q, int32_t heart_rate_bpm) {
+  if (heart_rate_bpm <= 0) {
+    return prv_energy_pandolf_mw(params, speed_mmps, grade_q, heart_rate_bpm);
+  }
+  int64_t kj_min_q4 = params->keytel_base_q4 + params->keytel_hr_q4 * heart_rate_bpm;
+  if (kj_min_q4 < 0) {
+    return 0;
+  }
+  // kJ/min * 1e4 -> mW: * 1e6 / 60 / 1e4
+  return (kj_min_q4 * 5) / 3;
+}
+
+static const EnergyModel ENERGY_MODELS[ENERGY_MODEL_COUNT] = {
+  [ENERGY_MODEL_PANDOLF] = { .name = "Pandolf", .evaluate = prv_energy_pandolf_mw },
+  [ENERGY_MODEL_LCDA]    = { .name = "LCDA",    .evaluate = prv_energy_lcda_mw },
+  [ENERGY_MODEL_KEYTEL]  = { .name = "Keytel",  .evaluate = prv_energy_keytel_mw },
+};
+
+static EnergyModelParams s_energy_params;
+static const EnergyModel *s_energy_model = &ENERGY_MODELS[ENERGY_MODEL_PANDOLF];
+
+static int32_t prv_profile_energy_model(int32_t profile_index) {
+  int32_t model = s_ext_settings.profile_energy_models[profile_index];
+  if (model < 0 || model >= ENERGY_MODEL_COUNT) {
+    return ENERGY_MODEL_PANDOLF;
+  }
+  return model;
+}
+
+static void prv_energy_model_prepare(EnergyModelParams *params, int32_t profile_index) {
+  const ProfileSettings *profile = &s_settings.profiles[profile_index];
+  int64_t weight = prv_weight_to_kg1000(s_settings.weight_value, s_settings.weight_unit);
+  int64_t load = prv_weight_to_kg1000(profile->ruck_weight_value, s_settings.ruck_weight_unit);
+  memset(params, 0, sizeof(*params));
+  params->weight_kg1000 = weight;
+  params->total_kg1000 = weight + load;
+  params->terrain_q = profile->terrain_factor;
+  if (weight > 0) {
+    params->ratio_q = (load * 1000000) / weight;
+    params->total_over_weight_q = ((weight + load) * 1000000) / weight;
+  }
+  int64_t ratio_sq_q = (params->ratio_q * params->ratio_q) / 1000000;
+  params->pandolf_standing_mw = (weight * 3) / 2 + (2 * params->total_kg1000 * ratio_sq_q) / 1000000;
+  params->pandolf_total_mu = (params->total_kg1000 * params->terrain_q) / 100;
+  params->lcda_standing_mw = (params->total_kg1000 * 144) / 100;
+
+  int64_t age = s_ext_settings.age_years;
+  if (s_ext_settings.sex == 1) {
+    params->keytel_base_q4 = -204022 - (1263 * weight) / 1000 + 740 * age;
+    params->keytel_hr_q4 = 4472;
+  } else {
+    params->keytel_base_q4 = -550969 + (1988 * weight) / 1000 + 2017 * age;
+    params->keytel_hr_q4 = 6309;
+  }
+}
 
-  return term1 + term2 + term3;
+// Rebuilds the active model and its constants; call whenever the profile or body settings change.
+static void prv_energy_model_refresh(void) {
+  int32_t profile_index = prv_active_profile_index();
+  s_energy_model = &ENERGY_MODELS[prv_profile_energy_model(profile_index)];
+  prv_energy_model_prepare(&s_energy_params, profile_index);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Energy model for profile %ld: %s", (long)profile_index, s_energy_model->name);
 }
 
 // ACSM walking estimate (no ruck adjustment): kcal/hour from bodyweight, speed, and grade.
-static int64_t prv_walking_kcal_per_hour(int64_t weight_kg1000, int64_t speed_mmps) {
+static int64_t prv_walking_kcal_per_hour(int64_t weight_kg1000, int64_t speed_mmps, int64_t grade_q) {
   // speed in m/min, Q1000
   int64_t speed_m_min_q1000 = speed_mmps * 60;
-  int64_t grade_q1000 = prv_active_profile()->grade_percent; // tenths of percent maps to grade fraction * 1000
+  int64_t grade_q1000 = grade_q / 10; // grade fraction * 1000
 
   // VO2 in ml/kg/min, Q1000: 3.5 + 0.1*S + 1.8*S*G
   int64_t vo2_q1000 = 3500;
@@ -350,6 +898,101 @@ static int64_t prv_walking_kcal_per_hour(int64_t weight_kg1000, int64_t speed_mm
   return (vo2_q1000 * weight_kg1000 * 3) / 10000000;
 }
 
+// Decoded icons are shared between windows and stay decoded after their last user releases them,
+// so moving between the picker and the dashboard does not pay for PNG decoding again. Idle
+// entries are dropped least-recently-used first when the heap runs low.
+typedef struct {
+  uint32_t resource_id;
+  GBitmap *bitmap;
+  uint16_t refs;
+  uint32_t last_used;
+} IconCacheEntry;
+
+static IconCacheEntry s_icon_cache[ICON_CACHE_SLOTS];
+static uint32_t s_icon_cache_clock = 0;
+
+static bool prv_icon_cache_evict_lru_idle(void) {
+  IconCacheEntry *victim = NULL;
+  for (int i = 0; i < ICON_CACHE_SLOTS; ++i) {
+    IconCacheEntry *entry = &s_icon_cache[i];
+    if (entry->bitmap && entry->refs == 0 && (!victim || entry->last_used < victim->last_used)) {
+      victim = entry;
+    }
+  }
+  if (!victim) {
+    return false;
+  }
+  gbitmap_destroy(victim->bitmap);
+  memset(victim, 0, sizeof(*victim));
+  return true;
+}
+
+// Releases idle icons until the heap is back above the low-water mark.
+static void prv_icon_cache_trim(void) {
+  while (heap_bytes_free() < ICON_CACHE_LOW_HEAP_BYTES && prv_icon_cache_evict_lru_idle()) {
+  }
+}
+
+static GBitmap *prv_icon_acquire(uint32_t resource_id) {
+  IconCacheEntry *free_slot = NULL;
+  for (int i = 0; i < ICON_CACHE_SLOTS; ++i) {
+    IconCacheEntry *entry = &s_icon_cache[i];
+    if (entry->bitmap && entry->resource_id == resource_id) {
+      entry->refs++;
+      entry->last_used = ++s_icon_cache_clock;
+      return entry->bitmap;
+    }
+    if (!entry->bitmap && !free_slot) {
+      free_slot = entry;
+    }
+  }
+  prv_icon_cache_trim();
+  if (!free_slot && prv_icon_cache_evict_lru_idle()) {
+    for (int i = 0; i < ICON_CACHE_SLOTS && !free_slot; ++i) {
+      if (!s_icon_cache[i].bitmap) {
+        free_slot = &s_icon_cache[i];
+      }
+    }
+  }
+  if (!free_slot) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Icon cache full, resource %lu not cached", (unsigned long)resource_id);
+    return NULL;
+  }
+  free_slot->bitmap = gbitmap_create_with_resource(resource_id);
+  if (!free_slot->bitmap) {
+    return NULL;
+  }
+  free_slot->resource_id = resource_id;
+  free_slot->refs = 1;
+  free_slot->last_used = ++s_icon_cache_clock;
+  return free_slot->bitmap;
+}
+
+static void prv_icon_release(GBitmap *bitmap) {
+  if (!bitmap) {
+    return;
+  }
+  for (int i = 0; i < ICON_CACHE_SLOTS; ++i) {
+    IconCacheEntry *entry = &s_icon_cache[i];
+    if (entry->bitmap == bitmap) {
+      if (entry->refs > 0) {
+        entry->refs--;
+      }
+      break;
+    }
+  }
+  prv_icon_cache_trim();
+}
+
+static void prv_icon_cache_destroy(void) {
+  for (int i = 0; i < ICON_CACHE_SLOTS; ++i) {
+    if (s_icon_cache[i].bitmap) {
+      gbitmap_destroy(s_icon_cache[i].bitmap);
+    }
+  }
+  memset(s_icon_cache, 0, sizeof(s_icon_cache));
+}
+
 static void prv_set_text_style(TextLayer *layer, GFont font, GTextAlignment align, GColor color) {
   text_layer_set_background_color(layer, GColorClear);
   text_layer_set_text_color(layer, color);
@@ -378,6 +1021,10 @@ static void prv_load_settings(void) {
   if (persist_exists(SETTINGS_PERSIST_KEY)) {
     persist_read_data(SETTINGS_PERSIST_KEY, &s_settings, sizeof(s_settings));
   }
+  s_ext_settings = EXTENDED_SETTINGS_DEFAULTS;
+  if (persist_exists(EXTENDED_SETTINGS_PERSIST_KEY)) {
+    persist_read_data(EXTENDED_SETTINGS_PERSIST_KEY, &s_ext_settings, sizeof(s_ext_settings));
+  }
   for (int i = 0; i < PROFILE_COUNT; ++i) {
     s_settings.profiles[i].terrain_factor = prv_normalize_terrain_factor(s_settings.profiles[i].terrain_factor);
     if (s_settings.profile_terrain_types[i][0] == '\0') {
@@ -396,139 +1043,2648 @@ static void prv_load_settings(void) {
 
 static void prv_save_settings(void) {
   persist_write_data(SETTINGS_PERSIST_KEY, &s_settings, sizeof(s_settings));
+  persist_write_data(EXTENDED_SETTINGS_PERSIST_KEY, &s_ext_settings, sizeof(s_ext_settings));
 }
 
-static void prv_send_lifetime_totals(void) {
-  DictionaryIterator *iter = NULL;
-  AppMessageResult result = app_message_outbox_begin(&iter);
-  if (result != APP_MSG_OK || !iter) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox begin failed for totals: %d", (int)result);
-    return;
-  }
-  dict_write_int32(iter, MESSAGE_KEY_lifetime_distance_m_total, s_lifetime_distance_m);
-  dict_write_int32(iter, MESSAGE_KEY_lifetime_calories_total, s_lifetime_calories);
-  dict_write_int32(iter, MESSAGE_KEY_last_activity_distance_m, s_last_activity_distance_m);
-  dict_write_int32(iter, MESSAGE_KEY_last_activity_calories,   s_last_activity_calories);
-  dict_write_int32(iter, MESSAGE_KEY_last_activity_pace_sec,   s_last_activity_pace_sec);
-  dict_write_int32(iter, MESSAGE_KEY_last_activity_timestamp,  s_last_activity_timestamp);
-  dict_write_end(iter);
-  result = app_message_outbox_send();
-  if (result != APP_MSG_OK) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed for totals: %d", (int)result);
+// --- Session histograms ----------------------------------------------------------------------
+// Fixed-bin time-in-band counters for heart-rate zone, pace, grade and carried load, advanced in
+// O(1) per accounting interval by the active seconds it covered. The footprint does not depend
+// on session length; the running set follows the checkpoint and the finished one is kept with
+// the last activity and sent to the phone as the raw record.
+
+#define HISTOGRAMS_VERSION 1
+#define HIST_HR_BINS 6              // no reading, <60 %, 60-70, 70-80, 80-90, >=90 % of max HR
+#define HIST_PACE_BINS 8            // stopped, then slowest to fastest pace band
+#define HIST_GRADE_BINS 6
+#define HIST_LOAD_BINS 6
+
+typedef enum {
+  HIST_KIND_HR_ZONE = 0,
+  HIST_KIND_PACE = 1,
+  HIST_KIND_GRADE = 2,
+  HIST_KIND_LOAD = 3,
+  HIST_KIND_COUNT
+} HistogramKind;
+
+// Lower edges of every bin after the first.
+static const int32_t HIST_HR_PCT_EDGES[HIST_HR_BINS - 2] = { 60, 70, 80, 90 };
+static const int32_t HIST_PACE_S_PER_KM_EDGES[HIST_PACE_BINS - 2] = { 900, 780, 720, 660, 600, 540 };
+static const int32_t HIST_GRADE_Q_EDGES[HIST_GRADE_BINS - 1] = { -600, -200, 200, 600, 1000 };
+static const int32_t HIST_LOAD_KG1000_EDGES[HIST_LOAD_BINS - 1] = { 1000, 10000, 15000, 20000, 30000 };
+
+// Persisted and sent as is; keep the fields 4-byte aligned and append only.
+typedef struct {
+  uint8_t version;
+  uint8_t bins[HIST_KIND_COUNT];  // bin count per kind, so the phone decodes without a table
+  uint8_t reserved[3];
+  int32_t start_time;             // session the counters belong to
+  uint32_t hr_zone_s[HIST_HR_BINS];
+  uint32_t pace_s[HIST_PACE_BINS];
+  uint32_t grade_s[HIST_GRADE_BINS];
+  uint32_t load_s[HIST_LOAD_BINS];
+} SessionHistograms;
+
+static SessionHistograms s_histograms;
+static SessionHistograms s_last_histograms;
+static int64_t s_histograms_active_s = 0;
+
+static uint8_t prv_hist_bin(const int32_t *edges, uint8_t edge_count, int64_t value) {
+  uint8_t bin = 0;
+  while (bin < edge_count && value >= edges[bin]) {
+    bin++;
   }
+  return bin;
 }
 
-static void prv_commit_session_totals(const char *reason) {
-  if (s_session_totals_committed) {
+static void prv_histograms_reset(int32_t start_time, int64_t active_s) {
+  memset(&s_histograms, 0, sizeof(s_histograms));
+  s_histograms.version = HISTOGRAMS_VERSION;
+  s_histograms.bins[HIST_KIND_HR_ZONE] = HIST_HR_BINS;
+  s_histograms.bins[HIST_KIND_PACE] = HIST_PACE_BINS;
+  s_histograms.bins[HIST_KIND_GRADE] = HIST_GRADE_BINS;
+  s_histograms.bins[HIST_KIND_LOAD] = HIST_LOAD_BINS;
+  s_histograms.start_time = start_time;
+  s_histograms_active_s = active_s;
+}
+
+static void prv_histograms_update(int64_t active_s, int64_t speed_mmps, int64_t grade_q, int32_t heart_rate_bpm,
+                                  int64_t load_kg1000) {
+  int64_t dt = active_s - s_histograms_active_s;
+  s_histograms_active_s = active_s;
+  if (dt <= 0) {
     return;
   }
-  if (s_session_distance_m <= 0 && s_session_calories <= 0) {
-    s_session_totals_committed = true;
-    return;
+  uint8_t hr_bin = 0;
+  int32_t max_hr = 220 - s_ext_settings.age_years;
+  if (heart_rate_bpm > 0 && max_hr > 0) {
+    hr_bin = 1 + prv_hist_bin(HIST_HR_PCT_EDGES, ARRAY_LENGTH(HIST_HR_PCT_EDGES), heart_rate_bpm * 100 / max_hr);
   }
-  int64_t lifetime_distance_m = (int64_t)s_lifetime_distance_m + s_session_distance_m;
-  int64_t lifetime_calories = (int64_t)s_lifetime_calories + s_session_calories;
-  if (lifetime_distance_m > INT32_MAX) {
-    lifetime_distance_m = INT32_MAX;
+  uint8_t pace_bin = 0;
+  if (speed_mmps >= HISTORY_MIN_SPEED_MMPS) {
+    // Bands are on pace, which falls as speed rises: count the edges this speed is faster than.
+    pace_bin = 1;
+    while (pace_bin < HIST_PACE_BINS - 1 && speed_mmps * HIST_PACE_S_PER_KM_EDGES[pace_bin - 1] >= 1000000) {
+      pace_bin++;
+    }
   }
-  if (lifetime_calories > INT32_MAX) {
-    lifetime_calories = INT32_MAX;
+  s_histograms.hr_zone_s[hr_bin] += (uint32_t)dt;
+  s_histograms.pace_s[pace_bin] += (uint32_t)dt;
+  s_histograms.grade_s[prv_hist_bin(HIST_GRADE_Q_EDGES, ARRAY_LENGTH(HIST_GRADE_Q_EDGES), grade_q)] += (uint32_t)dt;
+  s_histograms.load_s[prv_hist_bin(HIST_LOAD_KG1000_EDGES, ARRAY_LENGTH(HIST_LOAD_KG1000_EDGES), load_kg1000)] += (uint32_t)dt;
+}
+
+static bool prv_histograms_read(uint32_t key, SessionHistograms *out) {
+  return persist_exists(key)
+         && persist_read_data(key, out, sizeof(*out)) == (int)sizeof(*out)
+         && out->version == HISTOGRAMS_VERSION;
+}
+
+static void prv_histograms_load(void) {
+  if (!prv_histograms_read(LAST_HISTOGRAMS_PERSIST_KEY, &s_last_histograms)) {
+    memset(&s_last_histograms, 0, sizeof(s_last_histograms));
   }
-  s_lifetime_distance_m = (int32_t)lifetime_distance_m;
-  s_lifetime_calories = (int32_t)lifetime_calories;
-  persist_write_int(LIFETIME_DISTANCE_M_PERSIST_KEY, s_lifetime_distance_m);
-  persist_write_int(LIFETIME_CALORIES_PERSIST_KEY, s_lifetime_calories);
-  s_session_totals_committed = true;
-  APP_LOG(APP_LOG_LEVEL_INFO, "Session totals committed (%s): +%ld m +%ld kcal, lifetime=%ldm/%ldkcal",
-          reason ? reason : "n/a",
-          (long)s_session_distance_m, (long)s_session_calories,
-          (long)s_lifetime_distance_m, (long)s_lifetime_calories);
 }
 
-static void prv_update_display(void) {
-  if (!s_top_time_layer) {
+// Restores the running counters next to a session checkpoint; a record from another session
+// means the checkpoint outlived it, so counting restarts.
+static void prv_histograms_restore(int32_t start_time, int64_t active_s) {
+  if (!prv_histograms_read(SESSION_HISTOGRAMS_PERSIST_KEY, &s_histograms) || s_histograms.start_time != start_time) {
+    prv_histograms_reset(start_time, active_s);
     return;
   }
-  time_t now = time(NULL);
-  int64_t elapsed_real_s = (int64_t)(now - s_start_time);
-  if (elapsed_real_s < 1) {
-    elapsed_real_s = 1;
-  }
-  int64_t elapsed_s = elapsed_real_s;
-  if (s_settings.sim_steps_enabled) {
-    elapsed_s *= EMULATOR_TIME_SCALE;
+  s_histograms_active_s = active_s;
+}
+
+static void prv_histograms_commit(void) {
+  persist_delete(SESSION_HISTOGRAMS_PERSIST_KEY);
+  s_last_histograms = s_histograms;
+  persist_write_data(LAST_HISTOGRAMS_PERSIST_KEY, &s_last_histograms, sizeof(s_last_histograms));
+}
+
+// --- Stride model ----------------------------------------------------------------------------
+// Stride length follows cadence, so each profile can carry a stride table fitted on the phone
+// from sessions with a measured distance: knot k is the stride in mm at 80 + 10 k steps/min, and
+// an all-zero table falls back to the configured constant. Distance is integrated per update as
+// the new steps times the stride at the current cadence, one interpolated lookup. While a session
+// runs the steps are also counted per cadence band; the counts go to the phone at commit as the
+// data the next fit is made from. Only single-profile sessions with a known cadence for nearly
+// every step are sent: anything else would fit one profile's table to another's strides.
+
+#define STRIDE_TABLES_VERSION 1
+#define STRIDE_KNOTS 8
+#define STRIDE_CADENCE_MIN_SPM 80
+#define STRIDE_CADENCE_STEP_SPM 10
+#define STRIDE_CALIBRATION_VERSION 1
+#define STRIDE_MAX_UNBANDED_PCT 5       // steps without a cadence a calibration may leave out
+
+typedef struct {
+  uint8_t version;
+  uint8_t reserved[3];
+  uint16_t stride_mm[PROFILE_COUNT][STRIDE_KNOTS];
+} StrideTables;
+
+// Sent as is; keep the fields 4-byte aligned and append only.
+typedef struct {
+  uint8_t version;
+  uint8_t profile;
+  uint8_t knots;
+  uint8_t reserved;
+  int32_t start_time;
+  int32_t distance_m;             // the watch's own estimate, for comparison on the phone
+  uint32_t band_steps[STRIDE_KNOTS];  // band k is centred on knot k
+} StrideCalibration;
+
+typedef struct {
+  int64_t distance_mm;
+  int32_t last_steps;
+  uint8_t profile;
+  bool calibrating;               // false after a checkpoint restore or a profile switch
+  uint32_t unbanded_steps;        // counted while the cadence was not known yet
+  StrideCalibration session;
+  StrideCalibration last;         // committed counts, waiting in the outbox
+} StrideModel;
+
+static StrideTables s_stride_tables;
+static StrideModel s_stride;
+
+static void prv_stride_tables_load(void) {
+  if (!persist_exists(STRIDE_TABLES_PERSIST_KEY)
+      || persist_read_data(STRIDE_TABLES_PERSIST_KEY, &s_stride_tables, sizeof(s_stride_tables))
+         != (int)sizeof(s_stride_tables)
+      || s_stride_tables.version != STRIDE_TABLES_VERSION) {
+    memset(&s_stride_tables, 0, sizeof(s_stride_tables));
+    s_stride_tables.version = STRIDE_TABLES_VERSION;
   }
+}
 
-  int32_t steps = 0;
-  int32_t steps_total_day = 0;
-  if (s_health_available) {
-    steps_total_day = (int32_t)health_service_sum(HealthMetricStepCount, s_day_start, now);
-    if (steps_total_day < 0) {
-      steps_total_day = 0;
-    }
+// Little-endian uint16 knots; an empty table clears the profile back to the constant stride.
+static void prv_stride_tables_store(int32_t profile_index, const uint8_t *data, uint16_t length) {
+  if (profile_index < 0 || profile_index >= PROFILE_COUNT) {
+    return;
   }
-  if (s_settings.sim_steps_enabled) {
-    steps = (int32_t)((elapsed_s * (int64_t)s_settings.sim_steps_spm) / 60);
-    if (s_health_available) {
-      steps_total_day = s_steps_baseline + steps;
-    } else {
-      steps_total_day = steps;
-    }
-  } else if (s_health_available) {
-    steps = steps_total_day - s_steps_baseline;
-    if (steps < 0) {
-      steps = 0;
-    }
+  uint16_t *knots = s_stride_tables.stride_mm[profile_index];
+  memset(knots, 0, sizeof(s_stride_tables.stride_mm[0]));
+  for (uint16_t k = 0; k < STRIDE_KNOTS && (k + 1) * 2 <= length; ++k) {
+    knots[k] = (uint16_t)(data[2 * k] | (data[2 * k + 1] << 8));
   }
+  persist_write_data(STRIDE_TABLES_PERSIST_KEY, &s_stride_tables, sizeof(s_stride_tables));
+  APP_LOG(APP_LOG_LEVEL_INFO, "Stride table for profile %ld: %u..%u mm",
+          (long)(profile_index + 1), (unsigned)knots[0], (unsigned)knots[STRIDE_KNOTS - 1]);
+}
 
-  int64_t stride_mm = prv_stride_to_mm(s_settings.stride_value, s_settings.stride_unit);
-  int64_t distance_mm = (int64_t)steps * stride_mm;
-  if (s_last_time == 0) {
-    s_last_time = now;
-    s_last_steps = steps;
+static int64_t prv_stride_mm(uint8_t profile, int32_t cadence_spm) {
+  const uint16_t *knots = s_stride_tables.stride_mm[profile];
+  int32_t offset = cadence_spm - STRIDE_CADENCE_MIN_SPM;
+  if (offset < 0) {
+    offset = 0;
   }
-  int64_t speed_mmps = s_speed_mmps;
-  int64_t delta_s = (int64_t)(now - s_last_time);
-  int64_t delta_scaled_s = delta_s;
-  if (s_settings.sim_steps_enabled) {
-    delta_scaled_s *= EMULATOR_TIME_SCALE;
+  int32_t k = offset / STRIDE_CADENCE_STEP_SPM;
+  int32_t frac = offset % STRIDE_CADENCE_STEP_SPM;
+  if (k >= STRIDE_KNOTS - 1) {
+    k = STRIDE_KNOTS - 2;
+    frac = STRIDE_CADENCE_STEP_SPM;
   }
-  if (delta_scaled_s >= 5) {
-    int32_t delta_steps = steps - s_last_steps;
-    if (delta_steps < 0) {
+  int64_t lo = knots[k];
+  int64_t hi = knots[k + 1];
+  if (lo == 0 || hi == 0) {
+    return prv_stride_to_mm(s_settings.stride_value, s_settings.stride_unit);
+  }
+  return lo + (hi - lo) * frac / STRIDE_CADENCE_STEP_SPM;
+}
+
+static void prv_stride_start(uint8_t profile, int64_t distance_mm, int32_t steps, bool calibrating) {
+  s_stride.distance_mm = distance_mm;
+  s_stride.last_steps = steps;
+  s_stride.profile = profile;
+  s_stride.calibrating = calibrating;
+  s_stride.unbanded_steps = 0;
+  memset(&s_stride.session, 0, sizeof(s_stride.session));
+  s_stride.session.version = STRIDE_CALIBRATION_VERSION;
+  s_stride.session.profile = profile;
+  s_stride.session.knots = STRIDE_KNOTS;
+  s_stride.session.start_time = (int32_t)s_start_time;
+}
+
+// Session distance after the steps so far. A step count that goes back (a revised health
+// total) only moves the base; distance never runs backwards.
+static int64_t prv_stride_advance(int32_t steps, int32_t cadence_spm, bool count) {
+  int32_t delta = steps - s_stride.last_steps;
+  s_stride.last_steps = steps;
+  if (delta <= 0) {
+    return s_stride.distance_mm;
+  }
+  s_stride.distance_mm += (int64_t)delta * prv_stride_mm(s_stride.profile, cadence_spm);
+  if (!s_stride.calibrating || !count) {
+    return s_stride.distance_mm;
+  }
+  if (cadence_spm <= 0) {
+    s_stride.unbanded_steps += (uint32_t)delta;
+  } else {
+    int32_t band = (cadence_spm - STRIDE_CADENCE_MIN_SPM + STRIDE_CADENCE_STEP_SPM / 2) / STRIDE_CADENCE_STEP_SPM;
+    if (band < 0) {
+      band = 0;
+    }
+    if (band >= STRIDE_KNOTS) {
+      band = STRIDE_KNOTS - 1;
+    }
+    s_stride.session.band_steps[band] += (uint32_t)delta;
+  }
+  return s_stride.distance_mm;
+}
+
+// Later steps use the new profile's table; the session no longer calibrates either profile.
+static void prv_stride_switch_profile(uint8_t profile) {
+  s_stride.profile = profile;
+  s_stride.calibrating = false;
+}
+
+// Steps taken while paused (walking back to the car) move the base without adding distance.
+static void prv_stride_rebase(int32_t steps) {
+  s_stride.last_steps = steps;
+}
+
+// True when there is something for the phone to fit.
+static bool prv_stride_commit(int32_t distance_m) {
+  uint32_t steps = 0;
+  for (uint8_t k = 0; k < STRIDE_KNOTS; ++k) {
+    steps += s_stride.session.band_steps[k];
+  }
+  if (!s_stride.calibrating || steps == 0
+      || (uint64_t)s_stride.unbanded_steps * 100 > (uint64_t)(steps + s_stride.unbanded_steps) * STRIDE_MAX_UNBANDED_PCT) {
+    return false;
+  }
+  s_stride.last = s_stride.session;
+  s_stride.last.distance_m = distance_m;
+  return true;
+}
+
+// --- Ghost pace ------------------------------------------------------------------------------
+// Each profile keeps one reference session as a distance -> active-time table: point k is the
+// active second at which the session passed (k + 1) * step_m. The table is recorded on the fly;
+// when it fills, every other point is dropped and the step doubles, so any distance fits the same
+// record. The reference for the running session is read once at session start and the live gap
+// walks it with a forward-only cursor, so a tick costs O(1) and nothing is read during the ruck.
+
+#define GHOST_VERSION 1
+#define GHOST_MAX_POINTS 120          // 252-byte record, one persist key
+#define GHOST_BASE_STEP_M 100
+
+typedef enum {
+  GHOST_MODE_OFF = 0,
+  GHOST_MODE_LAST = 1,            // race the last session on this profile
+  GHOST_MODE_BEST = 2,            // race the fastest session on this profile
+} GhostMode;
+
+typedef struct {
+  uint16_t version;
+  uint16_t step_m;
+  uint16_t count;
+  uint16_t reserved;
+  int32_t start_time;
+  uint16_t elapsed_s[GHOST_MAX_POINTS];
+} GhostTable;
+
+typedef struct {
+  GhostTable ref;
+  GhostTable rec;
+  uint8_t profile;
+  bool recording;                 // false after a checkpoint restore: the table would have a gap
+  uint16_t cursor;                // ref point at or before the live distance
+  bool has_gap;
+  int32_t gap_s;                  // positive = behind the ghost
+} GhostPace;
+
+static GhostPace s_ghost;
+
+static bool prv_ghost_read(uint8_t profile, GhostTable *table) {
+  uint32_t key = GHOST_PROFILE1_PERSIST_KEY + profile;
+  return persist_exists(key)
+         && persist_read_data(key, table, sizeof(*table)) == (int)sizeof(*table)
+         && table->version == GHOST_VERSION && table->count <= GHOST_MAX_POINTS && table->step_m > 0;
+}
+
+static void prv_ghost_start(uint8_t profile, bool recording) {
+  memset(&s_ghost, 0, sizeof(s_ghost));
+  s_ghost.profile = profile;
+  s_ghost.recording = recording;
+  s_ghost.rec.version = GHOST_VERSION;
+  s_ghost.rec.step_m = GHOST_BASE_STEP_M;
+  s_ghost.rec.start_time = (int32_t)s_start_time;
+  if (s_ext_settings.ghost_mode == GHOST_MODE_OFF || !prv_ghost_read(profile, &s_ghost.ref)) {
+    s_ghost.ref.count = 0;
+  }
+}
+
+static void prv_ghost_record(int64_t distance_m, int64_t active_s) {
+  GhostTable *rec = &s_ghost.rec;
+  while (distance_m >= (int64_t)(rec->count + 1) * rec->step_m) {
+    if (rec->count == GHOST_MAX_POINTS) {
+      for (uint16_t i = 0; i < GHOST_MAX_POINTS / 2; ++i) {
+        rec->elapsed_s[i] = rec->elapsed_s[2 * i + 1];
+      }
+      rec->count = GHOST_MAX_POINTS / 2;
+      rec->step_m *= 2;
+      continue;
+    }
+    rec->elapsed_s[rec->count++] = (uint16_t)(active_s > UINT16_MAX ? UINT16_MAX : active_s);
+  }
+}
+
+// Active seconds the reference took to reach distance_m, interpolated between table points.
+static int64_t prv_ghost_ref_time(const GhostTable *ref, uint16_t index, int64_t distance_m) {
+  int64_t prev_m = (int64_t)index * ref->step_m;
+  int64_t prev_s = index > 0 ? ref->elapsed_s[index - 1] : 0;
+  int64_t next_s = ref->elapsed_s[index];
+  return prev_s + (next_s - prev_s) * (distance_m - prev_m) / ref->step_m;
+}
+
+static void prv_ghost_update(int64_t distance_m, int64_t active_s) {
+  if (s_ghost.recording) {
+    prv_ghost_record(distance_m, active_s);
+  }
+  const GhostTable *ref = &s_ghost.ref;
+  while (s_ghost.cursor < ref->count && distance_m >= (int64_t)(s_ghost.cursor + 1) * ref->step_m) {
+    s_ghost.cursor++;
+  }
+  s_ghost.has_gap = s_ghost.cursor < ref->count;
+  if (s_ghost.has_gap) {
+    s_ghost.gap_s = (int32_t)(active_s - prv_ghost_ref_time(ref, s_ghost.cursor, distance_m));
+  }
+}
+
+// A session that changes profile is a clean run of neither profile: it stops racing the start
+// profile's reference and records nothing.
+static void prv_ghost_stop(void) {
+  s_ghost.recording = false;
+  s_ghost.ref.count = 0;
+  s_ghost.has_gap = false;
+}
+
+// Time the table took to cover distance_m, or -1 when it stops short of it.
+static int64_t prv_ghost_time_at(const GhostTable *table, int64_t distance_m) {
+  uint16_t index = (uint16_t)(distance_m / table->step_m);
+  if (distance_m <= 0 || index > table->count || (index == table->count && distance_m % table->step_m)) {
+    return -1;
+  }
+  if (index == table->count) {
+    return table->elapsed_s[index - 1];
+  }
+  return prv_ghost_ref_time(table, index, distance_m);
+}
+
+static void prv_ghost_commit(void) {
+  const GhostTable *rec = &s_ghost.rec;
+  if (!s_ghost.recording || rec->count == 0) {
+    return;
+  }
+  if (s_ext_settings.ghost_mode == GHOST_MODE_BEST) {
+    // Read again: the table loaded at start is empty when the mode was switched mid-session.
+    GhostTable best;
+    if (prv_ghost_read(s_ghost.profile, &best) && best.count > 0) {
+      int64_t best_m = (int64_t)best.count * best.step_m;
+      int64_t rec_s = prv_ghost_time_at(rec, best_m);
+      if (rec_s < 0 || rec_s >= best.elapsed_s[best.count - 1]) {
+        return;
+      }
+    }
+  }
+  persist_write_data(GHOST_PROFILE1_PERSIST_KEY + s_ghost.profile, rec, sizeof(*rec));
+}
+
+// One committed session for the phone's history, sent once per commit and again when a
+// recalculation changes it. Sent as is; keep the fields 4-byte aligned and append only.
+#define SESSION_RECORD_VERSION 1
+
+typedef struct {
+  uint8_t version;
+  uint8_t reserved[3];
+  int32_t start_time;
+  int32_t distance_m;
+  int32_t energy_kcal;
+  int32_t pace_s;                 // per km
+  int32_t elapsed_s;
+} SessionRecord;
+
+static SessionRecord s_session_record;
+
+// Outbound AppMessage queue. Each message type is a pending bit plus a writer that serialises the
+// current state when the outbox is free, so repeated enqueues coalesce into the newest snapshot.
+// One message is in flight at a time; failures back off exponentially, and nothing is sent while
+// the phone is disconnected.
+typedef enum {
+  OUTBOX_MSG_TOTALS = 0,
+  OUTBOX_MSG_HISTOGRAMS = 1,
+  OUTBOX_MSG_STRIDE_CALIBRATION = 2,
+  OUTBOX_MSG_SESSION_RECORD = 3,
+  OUTBOX_MSG_COUNT
+} OutboxMessageType;
+
+typedef void (*OutboxWriteFn)(DictionaryIterator *iter);
+
+typedef struct {
+  uint32_t pending;             // bit per OutboxMessageType
+  int8_t in_flight;             // OutboxMessageType or -1
+  uint8_t attempts;             // consecutive failures
+  bool connected;
+  AppTimer *retry_timer;
+} OutboxQueue;
+
+static OutboxQueue s_outbox = { .in_flight = -1, .connected = true };
+
+static void prv_outbox_write_totals(DictionaryIterator *iter) {
+  dict_write_int32(iter, MESSAGE_KEY_lifetime_distance_m_total, s_lifetime_distance_m);
+  dict_write_int32(iter, MESSAGE_KEY_lifetime_calories_total, s_lifetime_calories);
+  dict_write_int32(iter, MESSAGE_KEY_last_activity_distance_m, s_last_activity_distance_m);
+  dict_write_int32(iter, MESSAGE_KEY_last_activity_calories,   s_last_activity_calories);
+  dict_write_int32(iter, MESSAGE_KEY_last_activity_pace_sec,   s_last_activity_pace_sec);
+  dict_write_int32(iter, MESSAGE_KEY_last_activity_timestamp,  s_last_activity_timestamp);
+}
+
+// 116 bytes of payload: fits the 128-byte outbox with the tuple header.
+static void prv_outbox_write_histograms(DictionaryIterator *iter) {
+  dict_write_data(iter, MESSAGE_KEY_session_histograms, (const uint8_t *)&s_last_histograms,
+                  sizeof(s_last_histograms));
+}
+
+static void prv_outbox_write_stride_calibration(DictionaryIterator *iter) {
+  dict_write_data(iter, MESSAGE_KEY_stride_calibration, (const uint8_t *)&s_stride.last, sizeof(s_stride.last));
+}
+
+static void prv_outbox_write_session_record(DictionaryIterator *iter) {
+  dict_write_data(iter, MESSAGE_KEY_session_record, (const uint8_t *)&s_session_record, sizeof(s_session_record));
+}
+
+static const OutboxWriteFn OUTBOX_WRITERS[OUTBOX_MSG_COUNT] = {
+  [OUTBOX_MSG_TOTALS] = prv_outbox_write_totals,
+  [OUTBOX_MSG_HISTOGRAMS] = prv_outbox_write_histograms,
+  [OUTBOX_MSG_STRIDE_CALIBRATION] = prv_outbox_write_stride_calibration,
+  [OUTBOX_MSG_SESSION_RECORD] = prv_outbox_write_session_record,
+};
+
+static void prv_outbox_pump(void);
+
+static void prv_outbox_retry_callback(void *context) {
+  (void)context;
+  s_outbox.retry_timer = NULL;
+  prv_outbox_pump();
+}
+
+static void prv_outbox_schedule_retry(void) {
+  if (s_outbox.retry_timer || !s_outbox.connected) {
+    return;
+  }
+  if (s_outbox.attempts >= OUTBOX_MAX_ATTEMPTS) {
+    // Give up until the next enqueue or reconnect rather than keep waking the radio.
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Outbox giving up after %u attempts", (unsigned)s_outbox.attempts);
+    return;
+  }
+  uint32_t delay_ms = OUTBOX_RETRY_BASE_MS << s_outbox.attempts;
+  if (delay_ms > OUTBOX_RETRY_MAX_MS) {
+    delay_ms = OUTBOX_RETRY_MAX_MS;
+  }
+  s_outbox.retry_timer = app_timer_register(delay_ms, prv_outbox_retry_callback, NULL);
+}
+
+static void prv_outbox_pump(void) {
+  if (s_outbox.in_flight >= 0 || s_outbox.retry_timer || !s_outbox.connected || s_outbox.pending == 0) {
+    return;
+  }
+  int type = 0;
+  while (!(s_outbox.pending & (1u << type))) {
+    type++;
+  }
+  DictionaryIterator *iter = NULL;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result != APP_MSG_OK || !iter) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Outbox begin failed for type %d: %d", type, (int)result);
+    s_outbox.attempts++;
+    prv_outbox_schedule_retry();
+    return;
+  }
+  OUTBOX_WRITERS[type](iter);
+  dict_write_end(iter);
+  result = app_message_outbox_send();
+  if (result != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Outbox send failed for type %d: %d", type, (int)result);
+    s_outbox.attempts++;
+    prv_outbox_schedule_retry();
+    return;
+  }
+  s_outbox.pending &= ~(1u << type);
+  s_outbox.in_flight = (int8_t)type;
+}
+
+static void prv_outbox_enqueue(OutboxMessageType type) {
+  s_outbox.pending |= (1u << type);
+  s_outbox.attempts = 0;
+  prv_outbox_pump();
+}
+
+static void prv_outbox_sent_handler(DictionaryIterator *sent, void *context) {
+  (void)sent;
+  (void)context;
+  s_outbox.in_flight = -1;
+  s_outbox.attempts = 0;
+  prv_outbox_pump();
+}
+
+static void prv_outbox_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+  (void)failed;
+  (void)context;
+  APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox failed: %d", (int)reason);
+  if (s_outbox.in_flight >= 0) {
+    s_outbox.pending |= (1u << s_outbox.in_flight);
+    s_outbox.in_flight = -1;
+  }
+  s_outbox.attempts++;
+  prv_outbox_schedule_retry();
+}
+
+static void prv_outbox_connection_handler(bool connected) {
+  s_outbox.connected = connected;
+  if (!connected) {
+    if (s_outbox.retry_timer) {
+      app_timer_cancel(s_outbox.retry_timer);
+      s_outbox.retry_timer = NULL;
+    }
+    return;
+  }
+  s_outbox.attempts = 0;
+  prv_outbox_pump();
+}
+
+static void prv_outbox_init(void) {
+  s_outbox.connected = connection_service_peek_pebble_app_connection();
+  app_message_register_outbox_sent(prv_outbox_sent_handler);
+  app_message_register_outbox_failed(prv_outbox_failed_handler);
+  connection_service_subscribe((ConnectionHandlers) {
+    .pebble_app_connection_handler = prv_outbox_connection_handler,
+  });
+}
+
+static void prv_outbox_deinit(void) {
+  connection_service_unsubscribe();
+  if (s_outbox.retry_timer) {
+    app_timer_cancel(s_outbox.retry_timer);
+    s_outbox.retry_timer = NULL;
+  }
+}
+
+typedef struct {
+  int32_t steps;
+  int32_t steps_total_day;
+  int32_t heart_rate_bpm;
+  int32_t cadence_spm;          // over the speed window, any step source
+  int64_t elapsed_s;
+  int64_t distance_mm;
+  int64_t ruck_kcal_total;
+  int64_t walk_kcal_total;
+} SessionLive;
+
+static SessionLive s_live;
+
+// Weekly and monthly training volume, kept as two fixed rings in a single persist record and
+// updated in O(1) when a session is committed. Must stay within PERSIST_DATA_MAX_LENGTH.
+typedef struct {
+  uint16_t period;            // Monday-based week index or (year - 2000) * 12 + month
+  uint16_t sessions;
+  uint32_t distance_m;
+  uint32_t energy_kcal;
+  uint32_t moving_s;
+  uint32_t load_kgkm_x10;     // load kg * km, tenths
+} RollupBucket;
+
+typedef struct {
+  uint8_t week_head;
+  uint8_t month_head;
+  uint16_t version;
+  RollupBucket weeks[ROLLUP_WEEKS];
+  RollupBucket months[ROLLUP_MONTHS];
+} RollupStore;
+
+static RollupStore s_rollups;
+
+// Days since 1970-01-01 for a civil date (Howard Hinnant's algorithm).
+static int32_t prv_days_from_civil(int32_t y, int32_t m, int32_t d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  int32_t yoe = y - era * 400;
+  int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static void prv_civil_from_days(int32_t z, int32_t *y_out, int32_t *m_out, int32_t *d_out) {
+  z += 719468;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  int32_t doe = z - era * 146097;
+  int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int32_t mp = (5 * doy + 2) / 153;
+  int32_t d = doy - (153 * mp + 2) / 5 + 1;
+  int32_t m = mp + (mp < 10 ? 3 : -9);
+  *y_out = yoe + era * 400 + (m <= 2);
+  *m_out = m;
+  *d_out = d;
+}
+
+static void prv_rollup_periods(time_t when, uint16_t *week_out, uint16_t *month_out) {
+  struct tm *tm = localtime(&when);
+  if (!tm) {
+    *week_out = 0;
+    *month_out = 0;
+    return;
+  }
+  int32_t days = prv_days_from_civil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+  // 1970-01-01 was a Thursday; shift so weeks start on Monday.
+  *week_out = (uint16_t)((days + 3) / 7);
+  *month_out = (uint16_t)((tm->tm_year - 100) * 12 + tm->tm_mon);
+}
+
+// Returns the bucket for period, advancing the ring (and clearing skipped periods) if needed.
+// Work is bounded by the ring length regardless of how long the app went unused.
+static RollupBucket *prv_rollup_bucket(RollupBucket *ring, uint8_t *head, uint8_t len, uint16_t period) {
+  RollupBucket *current = &ring[*head];
+  if (current->period == period) {
+    return current;
+  }
+  if (current->period > period) {
+    for (uint8_t i = 1; i < len; ++i) {
+      RollupBucket *older = &ring[(*head + len - i) % len];
+      if (older->period == period) {
+        return older;
+      }
+    }
+    return current;
+  }
+  uint16_t gap = period - current->period;
+  uint16_t steps = gap < len ? gap : len;
+  for (uint16_t i = 0; i < steps; ++i) {
+    *head = (uint8_t)((*head + 1) % len);
+    memset(&ring[*head], 0, sizeof(RollupBucket));
+    ring[*head].period = (uint16_t)(period - (steps - 1 - i));
+  }
+  return &ring[*head];
+}
+
+static void prv_rollup_add(RollupBucket *bucket, int32_t distance_m, int32_t energy_kcal,
+                           int32_t moving_s, int64_t load_kg1000) {
+  bucket->sessions++;
+  bucket->distance_m += (uint32_t)(distance_m > 0 ? distance_m : 0);
+  bucket->energy_kcal += (uint32_t)(energy_kcal > 0 ? energy_kcal : 0);
+  bucket->moving_s += (uint32_t)(moving_s > 0 ? moving_s : 0);
+  bucket->load_kgkm_x10 += (uint32_t)((load_kg1000 * (distance_m > 0 ? distance_m : 0)) / 100000);
+}
+
+static void prv_rollups_load(void) {
+  memset(&s_rollups, 0, sizeof(s_rollups));
+  if (persist_exists(ROLLUPS_PERSIST_KEY)) {
+    persist_read_data(ROLLUPS_PERSIST_KEY, &s_rollups, sizeof(s_rollups));
+  }
+  if (s_rollups.version != ROLLUPS_VERSION || s_rollups.week_head >= ROLLUP_WEEKS
+      || s_rollups.month_head >= ROLLUP_MONTHS) {
+    memset(&s_rollups, 0, sizeof(s_rollups));
+    s_rollups.version = ROLLUPS_VERSION;
+  }
+}
+
+static void prv_rollups_record_session(time_t when, int32_t distance_m, int32_t energy_kcal,
+                                       int32_t moving_s, int64_t load_kg1000) {
+  uint16_t week = 0;
+  uint16_t month = 0;
+  prv_rollup_periods(when, &week, &month);
+  prv_rollup_add(prv_rollup_bucket(s_rollups.weeks, &s_rollups.week_head, ROLLUP_WEEKS, week),
+                 distance_m, energy_kcal, moving_s, load_kg1000);
+  prv_rollup_add(prv_rollup_bucket(s_rollups.months, &s_rollups.month_head, ROLLUP_MONTHS, month),
+                 distance_m, energy_kcal, moving_s, load_kg1000);
+  persist_write_data(ROLLUPS_PERSIST_KEY, &s_rollups, sizeof(s_rollups));
+}
+
+#if PBL_API_EXISTS(app_glance_reload)
+static char s_glance_subtitle[64];
+
+static void prv_glance_reload_callback(AppGlanceReloadSession *session, size_t limit, void *context) {
+  (void)context;
+  if (limit < 1) {
+    return;
+  }
+  AppGlanceSlice slice = {
+    .layout = {
+      .icon = APP_GLANCE_SLICE_DEFAULT_ICON,
+      .subtitle_template_string = s_glance_subtitle,
+    },
+    .expiration_time = APP_GLANCE_SLICE_NO_EXPIRATION,
+  };
+  AppGlanceResult result = app_glance_add_slice(session, slice);
+  if (result != APP_GLANCE_RESULT_SUCCESS) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Glance slice rejected: %d", (int)result);
+  }
+}
+#endif
+
+// Publishes last activity and lifetime totals to the launcher. The signature of the published
+// numbers is persisted so the glance is only rewritten when something visible changed.
+static void prv_glance_publish(void) {
+#if PBL_API_EXISTS(app_glance_reload)
+  bool use_imperial = (s_settings.weight_unit == 1);
+  int64_t unit_m = use_imperial ? 1609 : 1000;
+  const char *unit_label = use_imperial ? "mi" : "km";
+  int64_t last_x100 = ((int64_t)s_last_activity_distance_m * 100) / unit_m;
+  int64_t lifetime_units = (int64_t)s_lifetime_distance_m / unit_m;
+  int64_t pace_sec = use_imperial ? ((int64_t)s_last_activity_pace_sec * 1609) / 1000 : s_last_activity_pace_sec;
+
+  uint32_t signature = 2166136261u;
+  const int32_t parts[] = { (int32_t)last_x100, (int32_t)pace_sec, (int32_t)lifetime_units,
+                            s_settings.weight_unit };
+  for (size_t i = 0; i < ARRAY_LENGTH(parts); ++i) {
+    signature = (signature ^ (uint32_t)parts[i]) * 16777619u;
+  }
+  if (persist_exists(GLANCE_SIGNATURE_PERSIST_KEY)
+      && (uint32_t)persist_read_int(GLANCE_SIGNATURE_PERSIST_KEY) == signature) {
+    return;
+  }
+
+  if (pace_sec > 0) {
+    snprintf(s_glance_subtitle, sizeof(s_glance_subtitle), "Last %ld.%02ld%s %ld:%02ld/%s, total %ld%s",
+             (long)(last_x100 / 100), (long)(last_x100 % 100), unit_label,
+             (long)(pace_sec / 60), (long)(pace_sec % 60), unit_label,
+             (long)lifetime_units, unit_label);
+  } else {
+    snprintf(s_glance_subtitle, sizeof(s_glance_subtitle), "Last %ld.%02ld%s, total %ld%s",
+             (long)(last_x100 / 100), (long)(last_x100 % 100), unit_label,
+             (long)lifetime_units, unit_label);
+  }
+  app_glance_reload(prv_glance_reload_callback, NULL);
+  persist_write_int(GLANCE_SIGNATURE_PERSIST_KEY, (int32_t)signature);
+#endif
+}
+
+// --- Session segments ------------------------------------------------------------------------
+// A session is a run of segments, one per profile used. Switching profile mid-ruck closes the
+// open segment and opens another with the new profile's snapshot; session totals keep running, so
+// each tick only adds into the open segment and cost does not grow with the segment count.
+
+typedef struct {
+  uint8_t profile;
+  uint8_t energy_model;
+  uint16_t reserved;
+  int32_t load_kg1000;        // ruck load snapshot when the segment opened
+  int32_t start_active_s;     // session active time at open
+  int32_t start_distance_m;   // session distance at open
+  int32_t active_s;           // filled in on close
+  int32_t distance_m;         // filled in on close
+  int32_t energy_kcal;        // filled in on close
+} SessionSegment;
+
+typedef struct {
+  SessionSegment segments[SESSION_MAX_SEGMENTS];
+  uint8_t count;              // including the open segment, always the last one
+  int64_t open_energy_mj;
+} SessionSegments;
+
+static SessionSegments s_segments;
+
+static bool prv_session_in_progress(void) {
+  return s_segments.count > 0 && !s_session_totals_committed;
+}
+
+// Callers check prv_segments_full() first; a segment's snapshot is never relabelled.
+static void prv_segment_open(void) {
+  if (s_segments.count == SESSION_MAX_SEGMENTS) {
+    return;
+  }
+  s_segments.open_energy_mj = 0;
+  SessionSegment *segment = &s_segments.segments[s_segments.count++];
+  memset(segment, 0, sizeof(*segment));
+  segment->start_active_s = (int32_t)s_live.elapsed_s;
+  segment->start_distance_m = (int32_t)(s_live.distance_mm / 1000);
+  segment->profile = (uint8_t)prv_active_profile_index();
+  segment->energy_model = (uint8_t)prv_profile_energy_model(segment->profile);
+  segment->load_kg1000 = (int32_t)(s_energy_params.total_kg1000 - s_energy_params.weight_kg1000);
+}
+
+static bool prv_segments_full(void) {
+  return s_segments.count == SESSION_MAX_SEGMENTS;
+}
+
+static void prv_segment_close(void) {
+  if (s_segments.count == 0) {
+    return;
+  }
+  SessionSegment *segment = &s_segments.segments[s_segments.count - 1];
+  segment->active_s = (int32_t)s_live.elapsed_s - segment->start_active_s;
+  segment->distance_m = (int32_t)(s_live.distance_mm / 1000) - segment->start_distance_m;
+  segment->energy_kcal = (int32_t)(s_segments.open_energy_mj / 4184000);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Segment %u closed: profile %u, %lds, %ldm, %ldkcal",
+          (unsigned)s_segments.count, (unsigned)segment->profile, (long)segment->active_s,
+          (long)segment->distance_m, (long)segment->energy_kcal);
+}
+
+static void prv_segments_reset(void) {
+  s_segments.count = 0;
+  s_segments.open_energy_mj = 0;
+  prv_segment_open();
+}
+
+// Active-time-weighted ruck load over the whole session, for the rollups.
+static int32_t prv_segments_mean_load_kg1000(void) {
+  int64_t weighted = 0;
+  int64_t total_s = 0;
+  for (uint8_t i = 0; i < s_segments.count; ++i) {
+    const SessionSegment *segment = &s_segments.segments[i];
+    int64_t active_s = (i + 1 == s_segments.count) ? s_live.elapsed_s - segment->start_active_s : segment->active_s;
+    weighted += (int64_t)segment->load_kg1000 * active_s;
+    total_s += active_s;
+  }
+  if (total_s <= 0) {
+    return s_segments.count ? s_segments.segments[s_segments.count - 1].load_kg1000 : 0;
+  }
+  return (int32_t)(weighted / total_s);
+}
+
+// --- Session samples and history -------------------------------------------------------------
+// While a session runs, speed and HR min/max plus cumulative energy are sampled into a fixed
+// buffer keyed by active time. When the buffer fills, adjacent samples merge pairwise and the
+// interval doubles, so memory stays bounded however long the ruck. At save the samples are
+// min/max-decimated to one entry per chart pixel column and persisted, so drawing the history
+// window is O(HISTORY_COLUMNS) and needs no pass over the raw data.
+
+typedef enum {
+  SESSION_SAMPLE_GRADE_FROM_PROFILE = 1 << 0,   // grade came from the profile setting, not a route
+} SessionSampleFlags;
+
+typedef struct {
+  uint16_t speed_min_mmps;
+  uint16_t speed_max_mmps;
+  uint16_t speed_mean_mmps;
+  int16_t grade_q;              // mean, percent * 100
+  uint16_t duration_s;          // active seconds covered
+  uint16_t energy_kcal;         // cumulative at the end of the sample
+  uint8_t hr_min;
+  uint8_t hr_max;
+  uint8_t hr_mean;              // 0 = no reading
+  uint8_t flags;                // SessionSampleFlags
+} SessionSample;
+
+typedef struct {
+  SessionSample samples[SESSION_SAMPLE_CAPACITY];
+  uint16_t count;
+  uint32_t interval_s;
+  int64_t next_at_s;            // active seconds closing the sample being accumulated
+  SessionSample pending;
+  bool pending_valid;
+  int64_t last_active_s;        // active seconds at the previous update
+  int64_t base_active_s;        // active time and energy before the first sample, non-zero after
+  int64_t base_energy_mj;       // a checkpoint restore
+  int64_t base_walk_kcal_s;
+} SessionSampler;
+
+static SessionSampler s_sampler;
+
+typedef struct {
+  uint8_t min;
+  uint8_t max;
+} HistoryRange;
+
+// Persisted last-session chart data. Pace is stored in HISTORY_PACE_UNIT_S units of s/km, energy
+// as a fraction of the session total; scale bounds are precomputed so drawing needs no scan.
+typedef struct {
+  uint16_t version;
+  uint16_t columns;
+  int32_t start_time;
+  int32_t duration_s;
+  int32_t energy_total_kcal;
+  int32_t distance_m;
+  uint8_t pace_lo;
+  uint8_t pace_hi;
+  uint8_t hr_lo;
+  uint8_t hr_hi;
+  HistoryRange pace[HISTORY_COLUMNS];
+  HistoryRange hr[HISTORY_COLUMNS];
+  uint8_t energy[HISTORY_COLUMNS];
+} SessionHistory;
+
+static SessionHistory *s_history;
+
+static void prv_sampler_reset(int64_t active_s) {
+  s_sampler.count = 0;
+  s_sampler.interval_s = SESSION_SAMPLE_BASE_INTERVAL_S;
+  s_sampler.next_at_s = active_s + SESSION_SAMPLE_BASE_INTERVAL_S;
+  s_sampler.pending_valid = false;
+  s_sampler.last_active_s = active_s;
+  s_sampler.base_active_s = active_s;
+  s_sampler.base_energy_mj = s_session_energy_mj;
+  s_sampler.base_walk_kcal_s = s_session_walk_kcal_s;
+}
+
+// Ranges widen; means are weighted by active time so merged samples stay valid model inputs.
+static void prv_sample_merge(SessionSample *into, const SessionSample *from) {
+  uint32_t total_s = (uint32_t)into->duration_s + from->duration_s;
+  if (total_s > 0) {
+    into->speed_mean_mmps = (uint16_t)(((uint32_t)into->speed_mean_mmps * into->duration_s
+                                        + (uint32_t)from->speed_mean_mmps * from->duration_s) / total_s);
+    into->grade_q = (int16_t)(((int32_t)into->grade_q * into->duration_s
+                               + (int32_t)from->grade_q * from->duration_s) / (int32_t)total_s);
+  }
+  if (from->hr_mean != 0 && into->hr_mean != 0 && total_s > 0) {
+    into->hr_mean = (uint8_t)(((uint32_t)into->hr_mean * into->duration_s
+                               + (uint32_t)from->hr_mean * from->duration_s) / total_s);
+  } else if (from->hr_mean != 0) {
+    into->hr_mean = from->hr_mean;
+  }
+  into->duration_s = (uint16_t)(total_s < UINT16_MAX ? total_s : UINT16_MAX);
+  into->flags &= from->flags;
+  if (from->speed_min_mmps < into->speed_min_mmps) {
+    into->speed_min_mmps = from->speed_min_mmps;
+  }
+  if (from->speed_max_mmps > into->speed_max_mmps) {
+    into->speed_max_mmps = from->speed_max_mmps;
+  }
+  if (from->hr_min != 0 && (into->hr_min == 0 || from->hr_min < into->hr_min)) {
+    into->hr_min = from->hr_min;
+  }
+  if (from->hr_max > into->hr_max) {
+    into->hr_max = from->hr_max;
+  }
+  into->energy_kcal = from->energy_kcal;
+}
+
+static void prv_sampler_push(const SessionSample *sample) {
+  if (s_sampler.count == SESSION_SAMPLE_CAPACITY) {
+    for (uint16_t i = 0; i < SESSION_SAMPLE_CAPACITY / 2; ++i) {
+      s_sampler.samples[i] = s_sampler.samples[2 * i];
+      prv_sample_merge(&s_sampler.samples[i], &s_sampler.samples[2 * i + 1]);
+    }
+    s_sampler.count = SESSION_SAMPLE_CAPACITY / 2;
+    s_sampler.interval_s *= 2;
+  }
+  s_sampler.samples[s_sampler.count++] = *sample;
+}
+
+static void prv_sampler_flush(void) {
+  if (s_sampler.pending_valid) {
+    prv_sampler_push(&s_sampler.pending);
+    s_sampler.pending_valid = false;
+  }
+}
+
+static void prv_sampler_update(int64_t active_s, int64_t speed_mmps, int64_t grade_q, bool grade_from_profile,
+                               int32_t heart_rate_bpm, int64_t energy_kcal) {
+  int64_t dt_s = active_s - s_sampler.last_active_s;
+  s_sampler.last_active_s = active_s;
+  SessionSample now_sample = {
+    .speed_min_mmps = (uint16_t)(speed_mmps > 0 ? (speed_mmps < UINT16_MAX ? speed_mmps : UINT16_MAX) : 0),
+    .grade_q = (int16_t)(grade_q < INT16_MIN ? INT16_MIN : (grade_q > INT16_MAX ? INT16_MAX : grade_q)),
+    .duration_s = (uint16_t)(dt_s > 0 ? (dt_s < UINT16_MAX ? dt_s : UINT16_MAX) : 0),
+    .hr_min = (uint8_t)(heart_rate_bpm > 0 && heart_rate_bpm < 255 ? heart_rate_bpm : 0),
+    .energy_kcal = (uint16_t)(energy_kcal < UINT16_MAX ? energy_kcal : UINT16_MAX),
+    .flags = grade_from_profile ? SESSION_SAMPLE_GRADE_FROM_PROFILE : 0,
+  };
+  now_sample.speed_max_mmps = now_sample.speed_min_mmps;
+  now_sample.speed_mean_mmps = now_sample.speed_min_mmps;
+  now_sample.hr_max = now_sample.hr_min;
+  now_sample.hr_mean = now_sample.hr_min;
+  if (s_sampler.pending_valid) {
+    prv_sample_merge(&s_sampler.pending, &now_sample);
+  } else {
+    s_sampler.pending = now_sample;
+    s_sampler.pending_valid = true;
+  }
+  if (active_s < s_sampler.next_at_s) {
+    return;
+  }
+  prv_sampler_flush();
+  // After a doubling the next boundary moves out with the new interval.
+  while (s_sampler.next_at_s <= active_s) {
+    s_sampler.next_at_s += s_sampler.interval_s;
+  }
+}
+
+static uint8_t prv_history_pace_unit(uint16_t speed_mmps) {
+  if (speed_mmps < HISTORY_MIN_SPEED_MMPS) {
+    return UINT8_MAX;
+  }
+  uint32_t pace = 1000000u / speed_mmps / HISTORY_PACE_UNIT_S;
+  return (uint8_t)(pace < UINT8_MAX ? pace : UINT8_MAX);
+}
+
+// Builds the per-column min/max series from the sampler in O(samples + columns).
+static void prv_history_build(SessionHistory *history, int32_t duration_s, int32_t distance_m) {
+  memset(history, 0, sizeof(*history));
+  history->version = SESSION_HISTORY_VERSION;
+  history->columns = HISTORY_COLUMNS;
+  history->start_time = (int32_t)s_start_time;
+  history->duration_s = duration_s;
+  history->distance_m = distance_m;
+  uint16_t count = s_sampler.count;
+  if (count == 0) {
+    history->columns = 0;
+    return;
+  }
+  uint16_t last_energy = s_sampler.samples[count - 1].energy_kcal;
+  history->energy_total_kcal = last_energy;
+  history->pace_lo = UINT8_MAX;
+  history->hr_lo = UINT8_MAX;
+  for (uint16_t col = 0; col < HISTORY_COLUMNS; ++col) {
+    uint16_t begin = (uint16_t)((uint32_t)col * count / HISTORY_COLUMNS);
+    uint16_t end = (uint16_t)((uint32_t)(col + 1) * count / HISTORY_COLUMNS);
+    if (end <= begin) {
+      end = begin + 1;
+    }
+    SessionSample merged = s_sampler.samples[begin];
+    for (uint16_t i = begin + 1; i < end; ++i) {
+      prv_sample_merge(&merged, &s_sampler.samples[i]);
+    }
+    HistoryRange pace = { prv_history_pace_unit(merged.speed_max_mmps), prv_history_pace_unit(merged.speed_min_mmps) };
+    HistoryRange hr = { merged.hr_min, merged.hr_max };
+    history->pace[col] = pace;
+    history->hr[col] = hr;
+    history->energy[col] = last_energy ? (uint8_t)((uint32_t)merged.energy_kcal * UINT8_MAX / last_energy) : 0;
+    if (pace.min < UINT8_MAX) {
+      history->pace_lo = pace.min < history->pace_lo ? pace.min : history->pace_lo;
+      history->pace_hi = pace.min > history->pace_hi ? pace.min : history->pace_hi;
+      if (pace.max < UINT8_MAX && pace.max > history->pace_hi) {
+        history->pace_hi = pace.max;
+      }
+    }
+    if (hr.min > 0) {
+      history->hr_lo = hr.min < history->hr_lo ? hr.min : history->hr_lo;
+      history->hr_hi = hr.max > history->hr_hi ? hr.max : history->hr_hi;
+    }
+  }
+}
+
+static void prv_persist_write_chunks(uint32_t first_key, uint32_t key_count, const void *data, size_t length) {
+  const uint8_t *bytes = data;
+  for (uint32_t i = 0; i < key_count; ++i) {
+    size_t offset = i * PERSIST_DATA_MAX_LENGTH;
+    if (offset >= length) {
+      persist_delete(first_key + i);
+      continue;
+    }
+    size_t chunk = length - offset;
+    if (chunk > PERSIST_DATA_MAX_LENGTH) {
+      chunk = PERSIST_DATA_MAX_LENGTH;
+    }
+    persist_write_data(first_key + i, bytes + offset, chunk);
+  }
+}
+
+static bool prv_persist_read_chunks(uint32_t first_key, uint32_t key_count, void *data, size_t length) {
+  uint8_t *bytes = data;
+  for (uint32_t i = 0; i < key_count; ++i) {
+    size_t offset = i * PERSIST_DATA_MAX_LENGTH;
+    if (offset >= length) {
+      break;
+    }
+    size_t chunk = length - offset;
+    if (chunk > PERSIST_DATA_MAX_LENGTH) {
+      chunk = PERSIST_DATA_MAX_LENGTH;
+    }
+    if (persist_read_data(first_key + i, bytes + offset, chunk) != (int)chunk) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void prv_history_save(int32_t duration_s, int32_t distance_m) {
+  prv_sampler_flush();
+  SessionHistory *history = malloc(sizeof(SessionHistory));
+  if (!history) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "History save skipped: out of memory");
+    return;
+  }
+  prv_history_build(history, duration_s, distance_m);
+  prv_persist_write_chunks(SESSION_HISTORY_FIRST_PERSIST_KEY, SESSION_HISTORY_PERSIST_KEYS, history, sizeof(*history));
+  APP_LOG(APP_LOG_LEVEL_INFO, "History saved: %u samples at %lus", (unsigned)s_sampler.count,
+          (unsigned long)s_sampler.interval_s);
+  free(s_history);
+  s_history = history;
+}
+
+static SessionHistory *prv_history_get(void) {
+  if (s_history) {
+    return s_history;
+  }
+  if (!persist_exists(SESSION_HISTORY_FIRST_PERSIST_KEY)) {
+    return NULL;
+  }
+  SessionHistory *history = malloc(sizeof(SessionHistory));
+  if (!history) {
+    return NULL;
+  }
+  if (!prv_persist_read_chunks(SESSION_HISTORY_FIRST_PERSIST_KEY, SESSION_HISTORY_PERSIST_KEYS, history, sizeof(*history))
+      || history->version != SESSION_HISTORY_VERSION || history->columns != HISTORY_COLUMNS) {
+    free(history);
+    return NULL;
+  }
+  s_history = history;
+  return s_history;
+}
+
+// Energy-model inputs of the last committed session, coarsened to RECALC_SAVED_INTERVALS so a
+// later settings fix can recalculate it. covered_kcal is the part of energy_kcal the intervals
+// account for (less than the total after a checkpoint restore); model_kcal is the intervals
+// evaluated with the settings the session ran under, the base a recalculation is compared with.
+typedef struct {
+  uint16_t duration_s;
+  uint16_t speed_mmps;
+  int16_t grade_q;
+  uint8_t heart_rate_bpm;
+  uint8_t profile;
+  uint8_t flags;                // SessionSampleFlags
+  uint8_t reserved;
+} RecalcInterval;
+
+typedef struct {
+  uint16_t version;
+  uint16_t count;
+  int32_t start_time;
+  int32_t finished_at;          // picks the rollup buckets
+  int32_t energy_kcal;          // what the session added to the totals
+  int32_t covered_kcal;
+  int32_t model_kcal;
+  RecalcInterval intervals[RECALC_SAVED_INTERVALS];
+} SavedSessionSeries;
+
+// Model constants the running session's energy was computed with, per profile. Captured when a
+// session starts and after each recalculation of it; a recalculation changes energy by the new
+// constants minus these over the same intervals, so unchanged settings change nothing.
+typedef struct {
+  EnergyModelParams params[PROFILE_COUNT];
+  const EnergyModel *models[PROFILE_COUNT];
+  int64_t profile_grade_q[PROFILE_COUNT];
+} RecalcBaseline;
+
+static RecalcBaseline s_recalc_baseline;
+
+static void prv_recalc_baseline_capture(void) {
+  for (int32_t i = 0; i < PROFILE_COUNT; ++i) {
+    s_recalc_baseline.models[i] = &ENERGY_MODELS[prv_profile_energy_model(i)];
+    prv_energy_model_prepare(&s_recalc_baseline.params[i], i);
+    s_recalc_baseline.profile_grade_q[i] = (int64_t)s_settings.profiles[i].grade_percent * 10;
+  }
+}
+
+static int64_t prv_interval_grade_q(const RecalcInterval *interval, int64_t profile_grade_q) {
+  return (interval->flags & SESSION_SAMPLE_GRADE_FROM_PROFILE) ? profile_grade_q : interval->grade_q;
+}
+
+static int64_t prv_interval_baseline_mj(const RecalcInterval *interval) {
+  int64_t grade_q = prv_interval_grade_q(interval, s_recalc_baseline.profile_grade_q[interval->profile]);
+  return s_recalc_baseline.models[interval->profile]->evaluate(&s_recalc_baseline.params[interval->profile],
+                                                              interval->speed_mmps, grade_q,
+                                                              interval->heart_rate_bpm) * interval->duration_s;
+}
+
+static uint8_t prv_segment_profile_at(int64_t active_s, uint8_t *cursor) {
+  while (*cursor + 1 < s_segments.count && s_segments.segments[*cursor + 1].start_active_s <= active_s) {
+    (*cursor)++;
+  }
+  return s_segments.count ? s_segments.segments[*cursor].profile : (uint8_t)prv_active_profile_index();
+}
+
+static void prv_series_save(time_t finished_at) {
+  SavedSessionSeries *series = malloc(sizeof(SavedSessionSeries));
+  if (!series) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Session series skipped: out of memory");
+    return;
+  }
+  memset(series, 0, sizeof(*series));
+  series->version = SAVED_SERIES_VERSION;
+  series->start_time = (int32_t)s_start_time;
+  series->finished_at = (int32_t)finished_at;
+  series->energy_kcal = s_session_calories;
+  uint16_t count = s_sampler.count;
+  uint16_t groups = count < RECALC_SAVED_INTERVALS ? count : RECALC_SAVED_INTERVALS;
+  int64_t active_s = s_sampler.base_active_s;
+  uint8_t segment = 0;
+  for (uint16_t g = 0; g < groups; ++g) {
+    uint16_t begin = (uint16_t)((uint32_t)g * count / groups);
+    uint16_t end = (uint16_t)((uint32_t)(g + 1) * count / groups);
+    SessionSample merged = s_sampler.samples[begin];
+    for (uint16_t i = begin + 1; i < end; ++i) {
+      prv_sample_merge(&merged, &s_sampler.samples[i]);
+    }
+    RecalcInterval *interval = &series->intervals[g];
+    interval->duration_s = merged.duration_s;
+    interval->speed_mmps = merged.speed_mean_mmps;
+    interval->grade_q = merged.grade_q;
+    interval->heart_rate_bpm = merged.hr_mean;
+    interval->flags = merged.flags;
+    interval->profile = prv_segment_profile_at(active_s + merged.duration_s / 2, &segment);
+    active_s += merged.duration_s;
+  }
+  series->count = groups;
+  int64_t model_mj = 0;
+  for (uint16_t g = 0; g < groups; ++g) {
+    model_mj += prv_interval_baseline_mj(&series->intervals[g]);
+  }
+  series->model_kcal = (int32_t)(model_mj / 4184000);
+  if (count > 0) {
+    series->covered_kcal = s_sampler.samples[count - 1].energy_kcal - (int32_t)(s_sampler.base_energy_mj / 4184000);
+  }
+  prv_persist_write_chunks(SAVED_SERIES_FIRST_PERSIST_KEY, SAVED_SERIES_PERSIST_KEYS, series, sizeof(*series));
+  free(series);
+}
+
+static void prv_commit_session_totals(const char *reason) {
+  if (s_session_totals_committed) {
+    return;
+  }
+  persist_delete(SESSION_CHECKPOINT_PERSIST_KEY);
+  if (s_session_distance_m <= 0 && s_session_calories <= 0) {
+    s_session_totals_committed = true;
+    return;
+  }
+  int64_t lifetime_distance_m = (int64_t)s_lifetime_distance_m + s_session_distance_m;
+  int64_t lifetime_calories = (int64_t)s_lifetime_calories + s_session_calories;
+  if (lifetime_distance_m > INT32_MAX) {
+    lifetime_distance_m = INT32_MAX;
+  }
+  if (lifetime_calories > INT32_MAX) {
+    lifetime_calories = INT32_MAX;
+  }
+  s_lifetime_distance_m = (int32_t)lifetime_distance_m;
+  s_lifetime_calories = (int32_t)lifetime_calories;
+  persist_write_int(LIFETIME_DISTANCE_M_PERSIST_KEY, s_lifetime_distance_m);
+  persist_write_int(LIFETIME_CALORIES_PERSIST_KEY, s_lifetime_calories);
+  s_session_totals_committed = true;
+  time_t finished_at = prv_session_now();
+  prv_rollups_record_session(finished_at, s_session_distance_m, s_session_calories,
+                             (int32_t)s_live.elapsed_s, prv_segments_mean_load_kg1000());
+  prv_history_save((int32_t)s_live.elapsed_s, s_session_distance_m);
+  prv_series_save(finished_at);
+  prv_histograms_commit();
+  prv_ghost_commit();
+  bool stride_calibrated = prv_stride_commit(s_session_distance_m);
+  s_session_record = (SessionRecord){
+    .version = SESSION_RECORD_VERSION,
+    .start_time = (int32_t)s_start_time,
+    .distance_m = s_session_distance_m,
+    .energy_kcal = s_session_calories,
+    .pace_s = s_session_pace_sec,
+    .elapsed_s = (int32_t)s_live.elapsed_s,
+  };
+  prv_glance_publish();
+  prv_outbox_enqueue(OUTBOX_MSG_TOTALS);
+  prv_outbox_enqueue(OUTBOX_MSG_SESSION_RECORD);
+  prv_outbox_enqueue(OUTBOX_MSG_HISTOGRAMS);
+  if (stride_calibrated) {
+    prv_outbox_enqueue(OUTBOX_MSG_STRIDE_CALIBRATION);
+  }
+  APP_LOG(APP_LOG_LEVEL_INFO, "Session totals committed (%s): +%ld m +%ld kcal, lifetime=%ldm/%ldkcal",
+          reason ? reason : "n/a",
+          (long)s_session_distance_m, (long)s_session_calories,
+          (long)s_lifetime_distance_m, (long)s_lifetime_calories);
+}
+
+// One recorded or synthetic trace step; the binary trace format is a packed array of these,
+// little-endian, both for compiled-in resources and for traces uploaded from the phone.
+typedef struct {
+  uint16_t duration_s;
+  uint8_t cadence_spm;      // 0 = stopped
+  uint8_t heart_rate_bpm;   // 0 = no reading
+  int16_t grade_tenths;     // tenths of percent, same scale as ProfileSettings.grade_percent
+} ReplayRecord;
+
+typedef enum {
+  REPLAY_IDLE = 0,
+  REPLAY_RUNNING,
+  REPLAY_DONE
+} ReplayState;
+
+typedef enum {
+  REPLAY_SOURCE_RESOURCE = 1,
+  REPLAY_SOURCE_UPLOADED = 2
+} ReplaySource;
+
+typedef struct {
+  ReplayState state;
+  ReplaySource source;
+  ReplayRecord *uploaded;     // heap, only while a phone trace is loaded
+  uint16_t uploaded_count;
+  uint16_t record_count;
+  uint16_t record_index;
+  ReplayRecord record;
+  uint32_t record_elapsed_s;
+  uint32_t speed;             // virtual seconds per real second
+  uint32_t debt_ms;           // virtual time owed to the next slice, ms
+  int64_t virtual_ms;         // replay timeline, the session clock's source while running
+  int32_t steps;
+  int32_t step_remainder;     // spm * s not yet turned into whole steps
+  int32_t heart_rate_bpm;
+  int64_t grade_q;
+  int64_t expected_steps;
+  uint32_t expected_duration_s;
+  uint32_t ticks;
+  uint32_t busy_ms;
+  uint32_t max_slice_ms;
+  AppTimer *timer;
+} ReplayEngine;
+
+static ReplayEngine s_replay;
+
+static bool prv_replay_feeding(void) {
+  return s_replay.state != REPLAY_IDLE;
+}
+
+// Simulated steps run the live session faster than real time; replays already set their own pace.
+static void prv_clock_sync_scale(void) {
+  prv_clock_set_scale(s_settings.sim_steps_enabled && !prv_replay_feeding() ? EMULATOR_TIME_SCALE : 1);
+}
+
+static void prv_session_pause(bool manual) {
+  if (s_paused) {
+    s_pause_manual = s_pause_manual || manual;
+    return;
+  }
+  s_paused = true;
+  s_pause_manual = manual;
+  prv_clock_set_paused(true);
+  s_speed_mmps = 0;
+  APP_LOG(APP_LOG_LEVEL_INFO, "Session paused (%s)", manual ? "manual" : "auto");
+}
+
+static void prv_session_resume(void) {
+  if (!s_paused) {
+    return;
+  }
+  s_paused = false;
+  s_pause_manual = false;
+  prv_clock_set_paused(false);
+  // Restart the speed window and motion timer from the resume point.
+  s_speed_window_ms = -1;
+  s_motion_last_ms = prv_clock_active_ms();
+  APP_LOG(APP_LOG_LEVEL_INFO, "Session resumed");
+}
+
+// Cadence-driven auto-pause: no step deltas for auto_pause_seconds pauses, the first new step
+// resumes. Manual pauses are only ended by the user.
+static void prv_auto_pause_update(int32_t steps, int64_t active_ms) {
+  if (steps != s_motion_last_steps) {
+    s_motion_last_steps = steps;
+    s_motion_last_ms = active_ms;
+    if (s_paused && !s_pause_manual) {
+      prv_session_resume();
+      if (!prv_replay_feeding()) {
+        vibes_short_pulse();
+      }
+    }
+    return;
+  }
+  if (s_paused || s_ext_settings.auto_pause_seconds <= 0) {
+    return;
+  }
+  if (active_ms - s_motion_last_ms >= (int64_t)s_ext_settings.auto_pause_seconds * 1000) {
+    prv_session_pause(false);
+    if (!prv_replay_feeding()) {
+      vibes_short_pulse();
+    }
+  }
+}
+
+// --- Interval workouts -----------------------------------------------------------------------
+// Workouts are compiled on the phone into a fixed-size instruction array. The runner only walks
+// the program at step boundaries; per tick it compares active time against precomputed limits.
+
+typedef enum {
+  WORKOUT_OP_END = 0,
+  WORKOUT_OP_STEP = 1,    // arg = WorkoutIntensity, value = duration s, pace = target s/km or 0
+  WORKOUT_OP_REPEAT = 2,  // arg = total iterations, value = index of the first looped instruction
+} WorkoutOp;
+
+typedef enum {
+  WORKOUT_INTENSITY_EASY = 0,
+  WORKOUT_INTENSITY_STEADY = 1,
+  WORKOUT_INTENSITY_HARD = 2,
+  WORKOUT_INTENSITY_WALK = 3,
+  WORKOUT_INTENSITY_COUNT
+} WorkoutIntensity;
+
+typedef enum {
+  WORKOUT_CUE_STEP,   // next step started
+  WORKOUT_CUE_DONE,
+  WORKOUT_CUE_SLOW,   // below the target pace band
+  WORKOUT_CUE_FAST,   // above the target pace band
+} WorkoutCue;
+
+typedef struct {
+  uint8_t op;
+  uint8_t arg;
+  uint16_t value;
+  uint16_t pace_s_per_km;
+} WorkoutInstr;
+
+typedef struct {
+  WorkoutInstr program[WORKOUT_MAX_INSTR];
+  uint8_t length;
+  uint8_t loop_done[WORKOUT_MAX_INSTR];
+  uint8_t pc;
+  bool running;
+  uint16_t step_number;
+  uint16_t step_total;
+  int64_t step_end_s;         // session active seconds at which the current step ends
+  int64_t pace_check_s;       // next pace comparison, 0 = current step has no target
+  int64_t pace_check_distance_mm;
+  int64_t pace_min_mmps;
+  int64_t pace_max_mmps;
+} WorkoutRunner;
+
+static WorkoutRunner s_workout;
+
+static const char *WORKOUT_INTENSITY_LABELS[WORKOUT_INTENSITY_COUNT] = {
+  "Easy", "Steady", "Hard", "Walk"
+};
+
+static const uint32_t WORKOUT_FAST_VIBE_SEGMENTS[] = { 80, 80, 80, 80, 80 };
+
+static void prv_workout_cue(WorkoutCue cue) {
+  if (prv_replay_feeding()) {
+    return;
+  }
+  switch (cue) {
+    case WORKOUT_CUE_STEP:
+      vibes_double_pulse();
+      break;
+    case WORKOUT_CUE_DONE:
+      vibes_long_pulse();
+      break;
+    case WORKOUT_CUE_SLOW:
+      vibes_short_pulse();
+      break;
+    case WORKOUT_CUE_FAST: {
+      VibePattern pattern = {
+        .durations = WORKOUT_FAST_VIBE_SEGMENTS,
+        .num_segments = ARRAY_LENGTH(WORKOUT_FAST_VIBE_SEGMENTS),
+      };
+      vibes_enqueue_custom_pattern(pattern);
+      break;
+    }
+  }
+}
+
+// Moves pc to the next STEP (taking REPEAT jumps) or END. Bounded so a malformed program with an
+// empty loop body cannot spin.
+static const WorkoutInstr *prv_workout_next_step(uint8_t *pc, uint8_t *loop_done) {
+  for (uint16_t guard = 0; guard < WORKOUT_MAX_INSTR * 4 && *pc < s_workout.length; ++guard) {
+    const WorkoutInstr *instr = &s_workout.program[*pc];
+    if (instr->op == WORKOUT_OP_STEP) {
+      return instr;
+    }
+    if (instr->op != WORKOUT_OP_REPEAT) {
+      break;
+    }
+    if (loop_done[*pc] + 1 < instr->arg && instr->value < *pc) {
+      loop_done[*pc]++;
+      *pc = (uint8_t)instr->value;
+    } else {
+      loop_done[*pc] = 0;
+      (*pc)++;
+    }
+  }
+  return NULL;
+}
+
+static void prv_workout_enter_step(const WorkoutInstr *step, int64_t start_s, int64_t distance_mm) {
+  s_workout.step_number++;
+  s_workout.step_end_s = start_s + step->value;
+  s_workout.pace_check_s = 0;
+  if (step->pace_s_per_km > 0) {
+    int64_t target_mmps = 1000000 / step->pace_s_per_km;
+    s_workout.pace_min_mmps = target_mmps * (100 - WORKOUT_PACE_TOLERANCE_PCT) / 100;
+    s_workout.pace_max_mmps = target_mmps * (100 + WORKOUT_PACE_TOLERANCE_PCT) / 100;
+    s_workout.pace_check_s = start_s + WORKOUT_PACE_CHECK_S;
+    s_workout.pace_check_distance_mm = distance_mm;
+  }
+}
+
+static void prv_workout_stop(void) {
+  s_workout.running = false;
+}
+
+static void prv_workout_start(int64_t active_s, int64_t distance_mm) {
+  s_workout.running = false;
+  s_workout.pc = 0;
+  s_workout.step_number = 0;
+  memset(s_workout.loop_done, 0, sizeof(s_workout.loop_done));
+  const WorkoutInstr *step = prv_workout_next_step(&s_workout.pc, s_workout.loop_done);
+  if (!step) {
+    return;
+  }
+  s_workout.running = true;
+  prv_workout_enter_step(step, active_s, distance_mm);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Workout started: %u steps", (unsigned)s_workout.step_total);
+}
+
+// Step boundary: chains steps off the previous end time so late ticks do not accumulate drift.
+// Catching up after coarse ticks or a restored session may cross several steps; cue once.
+static void prv_workout_advance(int64_t active_s, int64_t distance_mm) {
+  bool advanced = false;
+  while (s_workout.running && active_s >= s_workout.step_end_s) {
+    s_workout.pc++;
+    const WorkoutInstr *step = prv_workout_next_step(&s_workout.pc, s_workout.loop_done);
+    if (!step) {
+      s_workout.running = false;
+      prv_workout_cue(WORKOUT_CUE_DONE);
+      APP_LOG(APP_LOG_LEVEL_INFO, "Workout complete");
+      return;
+    }
+    prv_workout_enter_step(step, s_workout.step_end_s, distance_mm);
+    advanced = true;
+  }
+  if (advanced) {
+    prv_workout_cue(WORKOUT_CUE_STEP);
+  }
+}
+
+static void prv_workout_tick(int64_t active_s, int64_t distance_mm) {
+  if (!s_workout.running) {
+    return;
+  }
+  if (active_s >= s_workout.step_end_s) {
+    prv_workout_advance(active_s, distance_mm);
+    return;
+  }
+  if (s_workout.pace_check_s == 0 || active_s < s_workout.pace_check_s) {
+    return;
+  }
+  int64_t window_s = WORKOUT_PACE_CHECK_S + (active_s - s_workout.pace_check_s);
+  int64_t speed_mmps = (distance_mm - s_workout.pace_check_distance_mm) / window_s;
+  if (speed_mmps < s_workout.pace_min_mmps) {
+    prv_workout_cue(WORKOUT_CUE_SLOW);
+  } else if (speed_mmps > s_workout.pace_max_mmps) {
+    prv_workout_cue(WORKOUT_CUE_FAST);
+  }
+  s_workout.pace_check_s = active_s + WORKOUT_PACE_CHECK_S;
+  s_workout.pace_check_distance_mm = distance_mm;
+}
+
+// Total STEP executions including repeats, computed once per program for the "n/N" display.
+static uint16_t prv_workout_count_steps(void) {
+  uint8_t loop_done[WORKOUT_MAX_INSTR];
+  memset(loop_done, 0, sizeof(loop_done));
+  uint8_t pc = 0;
+  uint16_t total = 0;
+  while (total < 999 && prv_workout_next_step(&pc, loop_done)) {
+    total++;
+    pc++;
+  }
+  return total;
+}
+
+static void prv_workout_set_program(const uint8_t *data, uint16_t length, bool persist) {
+  uint16_t count = length / sizeof(WorkoutInstr);
+  if (count > WORKOUT_MAX_INSTR) {
+    count = WORKOUT_MAX_INSTR;
+  }
+  if (count == s_workout.length && memcmp(s_workout.program, data, count * sizeof(WorkoutInstr)) == 0) {
+    return;
+  }
+  prv_workout_stop();
+  memset(s_workout.program, 0, sizeof(s_workout.program));
+  memcpy(s_workout.program, data, count * sizeof(WorkoutInstr));
+  s_workout.length = (uint8_t)count;
+  s_workout.step_total = prv_workout_count_steps();
+  if (persist) {
+    persist_write_data(WORKOUT_PERSIST_KEY, s_workout.program, count * sizeof(WorkoutInstr));
+  }
+  APP_LOG(APP_LOG_LEVEL_INFO, "Workout program loaded: %u instructions, %u steps",
+          (unsigned)count, (unsigned)s_workout.step_total);
+}
+
+static void prv_workout_load(void) {
+  if (!persist_exists(WORKOUT_PERSIST_KEY)) {
+    return;
+  }
+  uint8_t buffer[WORKOUT_MAX_INSTR * sizeof(WorkoutInstr)];
+  int read = persist_read_data(WORKOUT_PERSIST_KEY, buffer, sizeof(buffer));
+  if (read > 0) {
+    prv_workout_set_program(buffer, (uint16_t)read, false);
+  }
+}
+
+// --- Accelerometer step detector -------------------------------------------------------------
+// Step source for watches without Health and a cross-check against Health counts. Samples arrive
+// in batches of ACCEL_BATCH_SAMPLES at 25 Hz; each batch is filtered and peak-picked in one pass
+// with integer math only. Per sample: vector magnitude, gravity removed by a slow EMA, a fast EMA
+// low-pass, then a peak above an adaptive threshold that is also outside the refractory window.
+
+typedef enum {
+  STEP_SOURCE_AUTO = 0,         // Health when available, otherwise the accelerometer
+  STEP_SOURCE_ACCEL = 1,        // accelerometer only
+  STEP_SOURCE_CROSS_CHECK = 2,  // Health drives, accelerometer runs alongside for comparison
+} StepSource;
+
+typedef struct {
+  bool subscribed;
+  int32_t steps;                // since subscribe
+  int32_t session_base;         // steps at session start
+  int32_t gravity_q4;           // slow EMA of magnitude, mg << 4
+  int32_t filtered;             // low-passed dynamic acceleration, mg
+  int32_t prev_filtered;
+  bool rising;
+  int32_t peak_avg;             // EMA of accepted peak heights, mg
+  uint64_t last_step_ms;
+  int32_t interval_avg_ms;      // EMA of step intervals
+  bool primed;
+  time_t cross_checked_at;
+} StepDetector;
+
+static StepDetector s_accel;
+
+static bool prv_accel_needed(void) {
+  switch ((StepSource)s_ext_settings.step_source) {
+    case STEP_SOURCE_ACCEL:
+    case STEP_SOURCE_CROSS_CHECK:
+      return true;
+    case STEP_SOURCE_AUTO:
+    default:
+      return !s_health_available;
+  }
+}
+
+// True when session step counts come from the accelerometer rather than Health.
+static bool prv_accel_is_step_source(void) {
+  return s_accel.subscribed
+         && (s_ext_settings.step_source == STEP_SOURCE_ACCEL || !s_health_available);
+}
+
+static int32_t prv_accel_session_steps(void) {
+  int32_t steps = s_accel.steps - s_accel.session_base;
+  return steps > 0 ? steps : 0;
+}
+
+static int32_t prv_accel_cadence_spm(uint64_t now_ms) {
+  if (s_accel.interval_avg_ms <= 0 || now_ms - s_accel.last_step_ms > ACCEL_MAX_STEP_INTERVAL_MS) {
+    return 0;
+  }
+  return 60000 / s_accel.interval_avg_ms;
+}
+
+static void prv_accel_process_sample(const AccelData *sample) {
+  int32_t x = sample->x;
+  int32_t y = sample->y;
+  int32_t z = sample->z;
+  int32_t magnitude = (int32_t)prv_isqrt((int64_t)x * x + (int64_t)y * y + (int64_t)z * z);
+  if (!s_accel.primed) {
+    s_accel.gravity_q4 = magnitude << 4;
+    s_accel.primed = true;
+  }
+  s_accel.gravity_q4 += ((magnitude << 4) - s_accel.gravity_q4) >> ACCEL_GRAVITY_SHIFT;
+  int32_t dynamic = magnitude - (s_accel.gravity_q4 >> 4);
+  s_accel.filtered += (dynamic - s_accel.filtered) >> ACCEL_LOWPASS_SHIFT;
+
+  int32_t threshold = s_ext_settings.accel_threshold_mg;
+  if (s_accel.peak_avg / 2 > threshold) {
+    threshold = s_accel.peak_avg / 2;
+  }
+  bool was_rising = s_accel.rising;
+  s_accel.rising = s_accel.filtered > s_accel.prev_filtered;
+  if (was_rising && !s_accel.rising && s_accel.prev_filtered >= threshold) {
+    uint64_t interval_ms = sample->timestamp - s_accel.last_step_ms;
+    if (interval_ms >= (uint64_t)s_ext_settings.accel_min_step_ms) {
+      s_accel.steps++;
+      s_accel.peak_avg += (s_accel.prev_filtered - s_accel.peak_avg) >> 3;
+      if (interval_ms <= ACCEL_MAX_STEP_INTERVAL_MS) {
+        s_accel.interval_avg_ms = s_accel.interval_avg_ms > 0
+          ? s_accel.interval_avg_ms + (((int32_t)interval_ms - s_accel.interval_avg_ms) >> 2)
+          : (int32_t)interval_ms;
+      }
+      s_accel.last_step_ms = sample->timestamp;
+    }
+  }
+  s_accel.prev_filtered = s_accel.filtered;
+}
+
+static void prv_update_display(void);
+
+static void prv_accel_data_handler(AccelData *data, uint32_t num_samples) {
+  if (num_samples > ACCEL_BATCH_SAMPLES) {
+    num_samples = ACCEL_BATCH_SAMPLES;
+  }
+  int32_t steps_before = s_accel.steps;
+  for (uint32_t i = 0; i < num_samples; ++i) {
+    // The motor shakes the sensor; drop those samples rather than count them as steps.
+    if (data[i].did_vibrate) {
+      continue;
+    }
+    prv_accel_process_sample(&data[i]);
+  }
+  // An auto-paused session ticks once a minute; a step resumes it now rather than at the next
+  // tick, so the walking in between is not lost from active time and energy.
+  if (s_paused && !s_pause_manual && s_accel.steps != steps_before) {
+    prv_update_display();
+  }
+}
+
+static void prv_accel_cross_check(time_t now, int32_t health_steps) {
+  if (s_ext_settings.step_source != STEP_SOURCE_CROSS_CHECK || !s_accel.subscribed
+      || now - s_accel.cross_checked_at < 60) {
+    return;
+  }
+  s_accel.cross_checked_at = now;
+  int32_t accel_steps = prv_accel_session_steps();
+  int32_t drift_pct = health_steps > 0 ? (accel_steps - health_steps) * 100 / health_steps : 0;
+  APP_LOG(APP_LOG_LEVEL_INFO, "Step cross-check: health=%ld accel=%ld (%ld%%) cadence=%ld",
+          (long)health_steps, (long)accel_steps, (long)drift_pct,
+          (long)prv_accel_cadence_spm((uint64_t)prv_clock_wall_ms()));
+}
+
+static void prv_accel_mark_session_start(void) {
+  s_accel.session_base = s_accel.steps;
+}
+
+static void prv_accel_apply_policy(void) {
+  bool needed = prv_accel_needed();
+  if (needed == s_accel.subscribed) {
+    return;
+  }
+  if (needed) {
+    accel_data_service_subscribe(ACCEL_BATCH_SAMPLES, prv_accel_data_handler);
+    accel_service_set_sampling_rate(ACCEL_SAMPLING_25HZ);
+    s_accel.primed = false;
+    APP_LOG(APP_LOG_LEVEL_INFO, "Accelerometer step detector on");
+  } else {
+    accel_data_service_unsubscribe();
+    APP_LOG(APP_LOG_LEVEL_INFO, "Accelerometer step detector off");
+  }
+  s_accel.subscribed = needed;
+}
+
+// --- Power governor --------------------------------------------------------------------------
+// Picks the least aggressive tier whose projected runtime still covers the rest of the planned
+// ruck. The battery level sets a floor tier regardless of plan. Drain is measured as percent per
+// NORMAL-equivalent second so time spent in cheaper tiers still counts toward the estimate.
+
+typedef enum {
+  POWER_TIER_NORMAL = 0,
+  POWER_TIER_SAVER = 1,
+  POWER_TIER_CRITICAL = 2,
+  POWER_TIER_COUNT
+} PowerTier;
+
+typedef struct {
+  const char *name;
+  uint16_t tick_interval_s;       // 1 = second ticks, 60 = minute ticks, otherwise app timer
+  bool redraw_secondary;          // day steps, walking kcal and pace header every tick
+  uint16_t hr_sample_period_s;    // 0 = system default
+  uint16_t checkpoint_interval_s; // shorter when low: a flat battery is the likeliest crash
+  uint16_t nominal_drain_mpct_h;  // milli-percent per hour before a measurement exists
+} PowerPolicy;
+
+static const PowerPolicy POWER_POLICIES[POWER_TIER_COUNT] = {
+  [POWER_TIER_NORMAL]   = { "normal",   1,  true,  5,  300, 8000 },
+  [POWER_TIER_SAVER]    = { "saver",    5,  false, 60, 180, 4000 },
+  [POWER_TIER_CRITICAL] = { "critical", 60, false, 0,  120, 2000 },
+};
+
+typedef struct {
+  PowerTier tier;
+  const PowerPolicy *policy;
+  uint8_t percent;
+  bool charging;
+  bool shortfall;                 // even CRITICAL is not projected to last the plan
+  time_t shortfall_at;
+  uint8_t ref_percent;            // drain measurement origin
+  time_t last_eval;
+  int64_t equiv_s;                // NORMAL-equivalent seconds since ref_percent
+  time_t secondary_drawn_at;
+  time_t checkpoint_at;
+  AppTimer *tick_timer;
+  uint16_t timer_interval_s;
+} PowerGovernor;
+
+static PowerGovernor s_power = {
+  .tier = POWER_TIER_NORMAL,
+  .policy = &POWER_POLICIES[POWER_TIER_NORMAL],
+  .percent = 100,
+};
+
+// Session state persisted at the governor's checkpoint cadence so a watch reset or crash does not
+// lose the ruck. Deleted when the session totals are committed.
+typedef struct {
+  uint16_t version;
+  uint8_t active_profile;
+  uint8_t flags;                  // bit 0 paused, bit 1 manual pause
+  int32_t start_time;
+  int32_t day_start;
+  int32_t steps_baseline;
+  int32_t saved_at;
+  int64_t active_ms;
+  int64_t energy_mj;
+  int64_t walk_kcal_s;
+  int32_t session_steps;          // lets the accelerometer source continue its count
+  int64_t open_segment_energy_mj;
+  uint8_t segment_count;
+  SessionSegment segments[SESSION_MAX_SEGMENTS];
+  int64_t distance_mm;            // integrated, so it cannot be rebuilt from the step count
+} SessionCheckpoint;
+
+static void prv_tick_policy_apply(void);
+
+static int64_t prv_power_drain_mpct_h(PowerTier tier) {
+  const int64_t normal_nominal = POWER_POLICIES[POWER_TIER_NORMAL].nominal_drain_mpct_h;
+  int64_t normal_rate = normal_nominal;
+  int32_t dropped = (int32_t)s_power.ref_percent - (int32_t)s_power.percent;
+  // Pebble reports charge in coarse steps; wait for one full step over a meaningful window.
+  if (dropped >= 10 && s_power.equiv_s >= 600) {
+    normal_rate = (int64_t)dropped * 1000 * 3600 / s_power.equiv_s;
+  }
+  return normal_rate * POWER_POLICIES[tier].nominal_drain_mpct_h / normal_nominal;
+}
+
+static int64_t prv_power_runtime_s(PowerTier tier) {
+  int64_t rate = prv_power_drain_mpct_h(tier);
+  return rate > 0 ? (int64_t)s_power.percent * 1000 * 3600 / rate : INT32_MAX;
+}
+
+static void prv_power_apply_tier(PowerTier tier) {
+  if (tier == s_power.tier) {
+    return;
+  }
+  s_power.tier = tier;
+  s_power.policy = &POWER_POLICIES[tier];
+  s_power.secondary_drawn_at = 0;
+#if PBL_API_EXISTS(health_service_set_heart_rate_sample_period)
+  health_service_set_heart_rate_sample_period(s_power.policy->hr_sample_period_s);
+#endif
+  APP_LOG(APP_LOG_LEVEL_INFO, "Power tier %s at %u%%", s_power.policy->name, (unsigned)s_power.percent);
+  if (s_tick_units != 0) {
+    prv_tick_policy_apply();
+  }
+}
+
+static void prv_power_evaluate(time_t now, int64_t active_s) {
+  if (s_power.last_eval != 0 && now > s_power.last_eval) {
+    s_power.equiv_s += (int64_t)(now - s_power.last_eval) * s_power.policy->nominal_drain_mpct_h
+                       / POWER_POLICIES[POWER_TIER_NORMAL].nominal_drain_mpct_h;
+  }
+  s_power.last_eval = now;
+
+  if (s_power.charging) {
+    s_power.shortfall = false;
+    prv_power_apply_tier(POWER_TIER_NORMAL);
+    return;
+  }
+  PowerTier tier = POWER_TIER_NORMAL;
+  if (s_power.percent <= 10) {
+    tier = POWER_TIER_CRITICAL;
+  } else if (s_power.percent <= 30) {
+    tier = POWER_TIER_SAVER;
+  }
+  bool shortfall = false;
+  int64_t planned_s = (int64_t)s_ext_settings.planned_duration_min * 60;
+  int64_t remaining_s = planned_s - active_s;
+  if (planned_s > 0 && remaining_s > 0) {
+    while (tier < POWER_TIER_CRITICAL && prv_power_runtime_s(tier) < remaining_s) {
+      tier++;
+    }
+    shortfall = prv_power_runtime_s(tier) < remaining_s;
+  }
+  if (shortfall && !s_power.shortfall) {
+    s_power.shortfall_at = now;
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Battery projected %lds short of plan (%lds left)",
+            (long)(remaining_s - prv_power_runtime_s(tier)), (long)remaining_s);
+    if (!prv_replay_feeding()) {
+      vibes_long_pulse();
+    }
+  }
+  s_power.shortfall = shortfall;
+  prv_power_apply_tier(tier);
+}
+
+static void prv_power_battery_handler(BatteryChargeState state) {
+  bool was_charging = s_power.charging;
+  s_power.percent = state.charge_percent;
+  s_power.charging = state.is_charging || state.is_plugged;
+  if (s_power.charging || was_charging || state.charge_percent > s_power.ref_percent) {
+    // Charging invalidates the drain measurement; start over from the current level.
+    s_power.ref_percent = state.charge_percent;
+    s_power.equiv_s = 0;
+  }
+  prv_power_evaluate(prv_session_now(), s_live.elapsed_s);
+}
+
+static void prv_power_init(void) {
+  BatteryChargeState state = battery_state_service_peek();
+  s_power.percent = state.charge_percent;
+  s_power.ref_percent = state.charge_percent;
+  s_power.charging = state.is_charging || state.is_plugged;
+  s_power.tier = POWER_TIER_COUNT;
+  prv_power_apply_tier(POWER_TIER_NORMAL);
+  prv_power_evaluate(prv_session_now(), 0);
+  battery_state_service_subscribe(prv_power_battery_handler);
+}
+
+static void prv_power_deinit(void) {
+  battery_state_service_unsubscribe();
+  if (s_power.tick_timer) {
+    app_timer_cancel(s_power.tick_timer);
+    s_power.tick_timer = NULL;
+  }
+#if PBL_API_EXISTS(health_service_set_heart_rate_sample_period)
+  health_service_set_heart_rate_sample_period(0);
+#endif
+}
+
+static void prv_checkpoint_save(time_t now) {
+  SessionCheckpoint checkpoint = {
+    .version = SESSION_CHECKPOINT_VERSION,
+    .active_profile = (uint8_t)prv_active_profile_index(),
+    .flags = (uint8_t)((s_paused ? 1 : 0) | (s_pause_manual ? 2 : 0)),
+    .start_time = (int32_t)s_start_time,
+    .day_start = (int32_t)s_day_start,
+    .steps_baseline = s_steps_baseline,
+    .saved_at = (int32_t)now,
+    .active_ms = prv_clock_active_ms(),
+    .energy_mj = s_session_energy_mj,
+    .walk_kcal_s = s_session_walk_kcal_s,
+    .session_steps = s_live.steps,
+    .open_segment_energy_mj = s_segments.open_energy_mj,
+    .segment_count = s_segments.count,
+    .distance_mm = s_stride.distance_mm,
+  };
+  memcpy(checkpoint.segments, s_segments.segments, sizeof(checkpoint.segments));
+  persist_write_data(SESSION_CHECKPOINT_PERSIST_KEY, &checkpoint, sizeof(checkpoint));
+  persist_write_data(SESSION_HISTOGRAMS_PERSIST_KEY, &s_histograms, sizeof(s_histograms));
+  s_power.checkpoint_at = now;
+}
+
+// Resumes an uncommitted session left by a reset or crash. The gap while the app was not running
+// is booked as paused time.
+static bool prv_checkpoint_restore(time_t now) {
+  SessionCheckpoint checkpoint;
+  if (!persist_exists(SESSION_CHECKPOINT_PERSIST_KEY)
+      || persist_read_data(SESSION_CHECKPOINT_PERSIST_KEY, &checkpoint, sizeof(checkpoint)) != (int)sizeof(checkpoint)
+      || checkpoint.version != SESSION_CHECKPOINT_VERSION
+      || checkpoint.saved_at > now || now - checkpoint.saved_at > SESSION_CHECKPOINT_MAX_GAP_S
+      || checkpoint.start_time > checkpoint.saved_at) {
+    persist_delete(SESSION_CHECKPOINT_PERSIST_KEY);
+    return false;
+  }
+  if (checkpoint.active_profile < PROFILE_COUNT) {
+    s_settings.active_profile = checkpoint.active_profile;
+  }
+  s_start_time = checkpoint.start_time;
+  s_day_start = checkpoint.day_start;
+  s_steps_baseline = checkpoint.steps_baseline;
+  s_paused = (checkpoint.flags & 1) != 0;
+  s_pause_manual = (checkpoint.flags & 2) != 0;
+  prv_clock_start(checkpoint.active_ms, s_paused);
+  s_session_energy_mj = checkpoint.energy_mj;
+  s_session_walk_kcal_s = checkpoint.walk_kcal_s;
+  s_accel.session_base = s_accel.steps - checkpoint.session_steps;
+  s_energy_last_ms = checkpoint.active_ms;
+  s_motion_last_ms = checkpoint.active_ms;
+  prv_sampler_reset(checkpoint.active_ms / 1000);
+  prv_histograms_restore(checkpoint.start_time, checkpoint.active_ms / 1000);
+  prv_ghost_start((uint8_t)prv_active_profile_index(), false);
+  prv_stride_start((uint8_t)prv_active_profile_index(), checkpoint.distance_mm, checkpoint.session_steps, false);
+  s_speed_window_ms = -1;
+  s_session_totals_committed = false;
+  s_power.checkpoint_at = now;
+  prv_energy_model_refresh();
+  prv_recalc_baseline_capture();
+  memcpy(s_segments.segments, checkpoint.segments, sizeof(s_segments.segments));
+  s_segments.count = checkpoint.segment_count;
+  s_segments.open_energy_mj = checkpoint.open_segment_energy_mj;
+  if (s_segments.count == 0 || s_segments.count > SESSION_MAX_SEGMENTS) {
+    prv_segments_reset();
+  }
+  if (s_segments.count > 1) {
+    prv_ghost_stop();
+  }
+  prv_workout_start(0, 0);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Session restored from checkpoint (gap %lds)", (long)(now - checkpoint.saved_at));
+  return true;
+}
+
+// Runs after each session update: governor re-evaluation rides on the checkpoint cadence so the
+// plan projection keeps up with elapsed time without a per-tick cost. It keeps that cadence after
+// a save; only a session the user started, and has not saved yet, is checkpointed.
+static void prv_power_session_update(time_t now, int64_t active_s) {
+  if (prv_replay_feeding()) {
+    return;
+  }
+  if (now - s_power.checkpoint_at >= s_power.policy->checkpoint_interval_s) {
+    if (prv_session_in_progress()) {
+      prv_checkpoint_save(now);
+    } else {
+      s_power.checkpoint_at = now;
+    }
+    prv_power_evaluate(now, active_s);
+  }
+}
+
+// --- Retroactive recalculation ---------------------------------------------------------------
+// Replays the stored samples of the running session, or the saved series of the last committed
+// one, through the energy model with the current settings. The job walks a few samples per app
+// timer slice so the UI stays responsive. A saved session's corrections land through a journal:
+// it is written once with every new absolute value, then applied and deleted, and re-applied on
+// the next launch if the app stopped in between, so totals never end up half updated.
+
+typedef enum {
+  RECALC_NONE = 0,
+  RECALC_CURRENT = 1,
+  RECALC_SAVED = 2,
+} RecalcTarget;
+
+typedef struct {
+  uint16_t version;
+  uint16_t week;
+  uint16_t month;
+  uint16_t reserved;
+  int32_t start_time;               // identifies the session in the series and history
+  int32_t lifetime_calories;
+  int32_t last_activity_calories;   // -1 = last activity is another session
+  int32_t week_kcal;
+  int32_t month_kcal;
+  int32_t session_kcal;
+  int32_t covered_kcal;
+  int32_t model_kcal;
+} RecalcJournal;
+
+typedef struct {
+  RecalcTarget target;
+  uint16_t index;
+  uint16_t count;
+  uint32_t sampler_interval_s;      // a sampler merge mid-job restarts the walk
+  uint8_t segment_count;
+  uint8_t segment;
+  int64_t active_s;
+  int64_t energy_mj;                // with the current settings
+  int64_t walk_kcal_s;
+  int64_t segment_mj[SESSION_MAX_SEGMENTS];
+  int64_t old_energy_mj;            // with s_recalc_baseline
+  int64_t old_walk_kcal_s;
+  int64_t segment_old_mj[SESSION_MAX_SEGMENTS];
+  int8_t params_profile;
+  EnergyModelParams params;
+  const EnergyModel *model;
+  SavedSessionSeries *saved;
+  AppTimer *timer;
+} RecalcJob;
+
+static RecalcJob s_recalc;
+
+static void prv_recalc_timer_callback(void *context);
+
+static void prv_recalc_use_profile(uint8_t profile) {
+  if (s_recalc.params_profile == (int8_t)profile) {
+    return;
+  }
+  s_recalc.params_profile = (int8_t)profile;
+  s_recalc.model = &ENERGY_MODELS[prv_profile_energy_model(profile)];
+  prv_energy_model_prepare(&s_recalc.params, profile);
+}
+
+static void prv_recalc_add(const RecalcInterval *interval) {
+  prv_recalc_use_profile(interval->profile);
+  int64_t grade_q = prv_interval_grade_q(interval, (int64_t)s_settings.profiles[interval->profile].grade_percent * 10);
+  int64_t metabolic_mw = s_recalc.model->evaluate(&s_recalc.params, interval->speed_mmps, grade_q,
+                                                  interval->heart_rate_bpm);
+  int64_t walk_kcal_per_hour = prv_walking_kcal_per_hour(s_recalc.params.weight_kg1000, interval->speed_mmps, grade_q);
+  int64_t energy_mj = metabolic_mw * interval->duration_s;
+  s_recalc.energy_mj += energy_mj;
+  s_recalc.walk_kcal_s += walk_kcal_per_hour * interval->duration_s;
+  s_recalc.segment_mj[s_recalc.segment] += energy_mj;
+  if (s_recalc.target != RECALC_CURRENT) {
+    return;
+  }
+  int64_t old_grade_q = prv_interval_grade_q(interval, s_recalc_baseline.profile_grade_q[interval->profile]);
+  int64_t old_mj = prv_interval_baseline_mj(interval);
+  s_recalc.old_energy_mj += old_mj;
+  s_recalc.old_walk_kcal_s += prv_walking_kcal_per_hour(s_recalc_baseline.params[interval->profile].weight_kg1000,
+                                                        interval->speed_mmps, old_grade_q) * interval->duration_s;
+  s_recalc.segment_old_mj[s_recalc.segment] += old_mj;
+}
+
+static void prv_recalc_reset_walk(void) {
+  s_recalc.index = 0;
+  s_recalc.energy_mj = 0;
+  s_recalc.walk_kcal_s = 0;
+  s_recalc.segment = 0;
+  s_recalc.params_profile = -1;
+  s_recalc.old_energy_mj = 0;
+  s_recalc.old_walk_kcal_s = 0;
+  memset(s_recalc.segment_mj, 0, sizeof(s_recalc.segment_mj));
+  memset(s_recalc.segment_old_mj, 0, sizeof(s_recalc.segment_old_mj));
+  if (s_recalc.target == RECALC_CURRENT) {
+    prv_sampler_flush();
+    s_recalc.count = s_sampler.count;
+    s_recalc.sampler_interval_s = s_sampler.interval_s;
+    s_recalc.segment_count = s_segments.count;
+    s_recalc.active_s = s_sampler.base_active_s;
+  } else {
+    s_recalc.count = s_recalc.saved->count;
+  }
+}
+
+static void prv_recalc_stop(void) {
+  if (s_recalc.timer) {
+    app_timer_cancel(s_recalc.timer);
+    s_recalc.timer = NULL;
+  }
+  free(s_recalc.saved);
+  s_recalc.saved = NULL;
+  s_recalc.target = RECALC_NONE;
+}
+
+static RollupBucket *prv_rollup_find(RollupBucket *ring, uint8_t len, uint16_t period) {
+  for (uint8_t i = 0; i < len; ++i) {
+    if (ring[i].period == period && period != 0) {
+      return &ring[i];
+    }
+  }
+  return NULL;
+}
+
+static void prv_recalc_journal_apply(const RecalcJournal *journal) {
+  s_lifetime_calories = journal->lifetime_calories;
+  persist_write_int(LIFETIME_CALORIES_PERSIST_KEY, s_lifetime_calories);
+  if (journal->last_activity_calories >= 0) {
+    s_last_activity_calories = journal->last_activity_calories;
+    persist_write_int(LAST_ACTIVITY_CALORIES_PERSIST_KEY, s_last_activity_calories);
+  }
+  RollupBucket *week = prv_rollup_find(s_rollups.weeks, ROLLUP_WEEKS, journal->week);
+  if (week) {
+    week->energy_kcal = (uint32_t)journal->week_kcal;
+  }
+  RollupBucket *month = prv_rollup_find(s_rollups.months, ROLLUP_MONTHS, journal->month);
+  if (month) {
+    month->energy_kcal = (uint32_t)journal->month_kcal;
+  }
+  persist_write_data(ROLLUPS_PERSIST_KEY, &s_rollups, sizeof(s_rollups));
+
+  SavedSessionSeries *series = malloc(sizeof(SavedSessionSeries));
+  if (series && prv_persist_read_chunks(SAVED_SERIES_FIRST_PERSIST_KEY, SAVED_SERIES_PERSIST_KEYS, series, sizeof(*series))
+      && series->version == SAVED_SERIES_VERSION && series->start_time == journal->start_time) {
+    series->energy_kcal = journal->session_kcal;
+    series->covered_kcal = journal->covered_kcal;
+    series->model_kcal = journal->model_kcal;
+    prv_persist_write_chunks(SAVED_SERIES_FIRST_PERSIST_KEY, SAVED_SERIES_PERSIST_KEYS, series, sizeof(*series));
+  }
+  free(series);
+  SessionHistory *history = prv_history_get();
+  if (history && history->start_time == journal->start_time) {
+    // The chart total is the whole session, restored-checkpoint energy included, not just the covered part.
+    history->energy_total_kcal = journal->session_kcal;
+    prv_persist_write_chunks(SESSION_HISTORY_FIRST_PERSIST_KEY, SESSION_HISTORY_PERSIST_KEYS, history, sizeof(*history));
+  }
+  persist_delete(RECALC_JOURNAL_PERSIST_KEY);
+  prv_glance_publish();
+  prv_outbox_enqueue(OUTBOX_MSG_TOTALS);
+  if (s_session_record.version == SESSION_RECORD_VERSION && s_session_record.start_time == journal->start_time) {
+    s_session_record.energy_kcal = journal->session_kcal;
+    prv_outbox_enqueue(OUTBOX_MSG_SESSION_RECORD);
+  }
+}
+
+// Re-applies a journal left by a recalculation that was interrupted after its commit point.
+static void prv_recalc_recover(void) {
+  RecalcJournal journal;
+  if (!persist_exists(RECALC_JOURNAL_PERSIST_KEY)) {
+    return;
+  }
+  if (persist_read_data(RECALC_JOURNAL_PERSIST_KEY, &journal, sizeof(journal)) == (int)sizeof(journal)
+      && journal.version == RECALC_JOURNAL_VERSION) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Re-applying interrupted recalculation");
+    prv_recalc_journal_apply(&journal);
+  } else {
+    persist_delete(RECALC_JOURNAL_PERSIST_KEY);
+  }
+}
+
+static void prv_recalc_finish_saved(void) {
+  const SavedSessionSeries *series = s_recalc.saved;
+  int32_t new_model = (int32_t)(s_recalc.energy_mj / 4184000);
+  int32_t delta = new_model - series->model_kcal;
+  int32_t new_covered = series->covered_kcal + delta > 0 ? series->covered_kcal + delta : 0;
+  uint16_t week = 0;
+  uint16_t month = 0;
+  prv_rollup_periods((time_t)series->finished_at, &week, &month);
+  RollupBucket *week_bucket = prv_rollup_find(s_rollups.weeks, ROLLUP_WEEKS, week);
+  RollupBucket *month_bucket = prv_rollup_find(s_rollups.months, ROLLUP_MONTHS, month);
+  int64_t lifetime = (int64_t)s_lifetime_calories + delta;
+  RecalcJournal journal = {
+    .version = RECALC_JOURNAL_VERSION,
+    .week = week,
+    .month = month,
+    .start_time = series->start_time,
+    .lifetime_calories = (int32_t)(lifetime < 0 ? 0 : (lifetime > INT32_MAX ? INT32_MAX : lifetime)),
+    .last_activity_calories = s_last_activity_timestamp >= series->start_time
+                              ? (s_last_activity_calories + delta > 0 ? s_last_activity_calories + delta : 0) : -1,
+    .week_kcal = week_bucket ? (int32_t)week_bucket->energy_kcal + delta : 0,
+    .month_kcal = month_bucket ? (int32_t)month_bucket->energy_kcal + delta : 0,
+    .session_kcal = series->energy_kcal + delta,
+    .covered_kcal = new_covered,
+    .model_kcal = new_model,
+  };
+  if (journal.week_kcal < 0) {
+    journal.week_kcal = 0;
+  }
+  if (journal.month_kcal < 0) {
+    journal.month_kcal = 0;
+  }
+  // The journal write is the commit point; everything after it can be redone from the journal.
+  persist_write_data(RECALC_JOURNAL_PERSIST_KEY, &journal, sizeof(journal));
+  prv_recalc_journal_apply(&journal);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Saved session recalculated: %+ld kcal", (long)delta);
+}
+
+static void prv_recalc_finish_current(void) {
+  // Ticks that ran during the walk already used the new settings; only the walked part changes.
+  int64_t delta_mj = s_recalc.energy_mj - s_recalc.old_energy_mj;
+  s_session_energy_mj += delta_mj;
+  s_session_walk_kcal_s += s_recalc.walk_kcal_s - s_recalc.old_walk_kcal_s;
+  if (s_session_energy_mj < 0) {
+    s_session_energy_mj = 0;
+  }
+  int64_t closed_delta_mj = 0;
+  for (uint8_t i = 0; i < s_segments.count; ++i) {
+    SessionSegment *segment = &s_segments.segments[i];
+    prv_recalc_use_profile(segment->profile);
+    segment->load_kg1000 = (int32_t)(s_recalc.params.total_kg1000 - s_recalc.params.weight_kg1000);
+    if (i + 1 < s_segments.count) {
+      int32_t segment_delta = (int32_t)(s_recalc.segment_mj[i] / 4184000 - s_recalc.segment_old_mj[i] / 4184000);
+      segment->energy_kcal += segment_delta;
+      closed_delta_mj += (int64_t)segment_delta * 4184000;
+    }
+  }
+  s_segments.open_energy_mj += delta_mj - closed_delta_mj;
+  s_session_calories = (int32_t)(s_session_energy_mj / 4184000);
+  s_live.ruck_kcal_total = s_session_calories;
+  s_live.walk_kcal_total = s_session_walk_kcal_s / 3600;
+  prv_recalc_baseline_capture();
+  prv_checkpoint_save(prv_session_now());
+  APP_LOG(APP_LOG_LEVEL_INFO, "Current session recalculated: %+ld kcal", (long)(delta_mj / 4184000));
+}
+
+static void prv_recalc_timer_callback(void *context) {
+  (void)context;
+  s_recalc.timer = NULL;
+  if (s_recalc.target == RECALC_CURRENT
+      && (s_sampler.interval_s != s_recalc.sampler_interval_s || s_segments.count != s_recalc.segment_count)) {
+    prv_recalc_reset_walk();
+  }
+  uint16_t end = s_recalc.index + RECALC_SLICE_SAMPLES;
+  if (end > s_recalc.count) {
+    end = s_recalc.count;
+  }
+  for (; s_recalc.index < end; ++s_recalc.index) {
+    if (s_recalc.target == RECALC_SAVED) {
+      prv_recalc_add(&s_recalc.saved->intervals[s_recalc.index]);
+      continue;
+    }
+    const SessionSample *sample = &s_sampler.samples[s_recalc.index];
+    RecalcInterval interval = {
+      .duration_s = sample->duration_s,
+      .speed_mmps = sample->speed_mean_mmps,
+      .grade_q = sample->grade_q,
+      .heart_rate_bpm = sample->hr_mean,
+      .flags = sample->flags,
+    };
+    interval.profile = prv_segment_profile_at(s_recalc.active_s + sample->duration_s / 2, &s_recalc.segment);
+    prv_recalc_add(&interval);
+    s_recalc.active_s += sample->duration_s;
+  }
+  if (s_recalc.index < s_recalc.count) {
+    s_recalc.timer = app_timer_register(RECALC_SLICE_MS, prv_recalc_timer_callback, NULL);
+    return;
+  }
+  if (s_recalc.target == RECALC_SAVED) {
+    prv_recalc_finish_saved();
+  } else {
+    prv_recalc_finish_current();
+  }
+  prv_recalc_stop();
+  vibes_short_pulse();
+  prv_update_display();
+}
+
+static void prv_recalc_start(RecalcTarget target) {
+  prv_recalc_stop();
+  if (target == RECALC_CURRENT && !prv_session_in_progress()) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Recalculation skipped: no session running");
+    return;
+  }
+  if (target == RECALC_SAVED) {
+    SavedSessionSeries *series = malloc(sizeof(SavedSessionSeries));
+    if (!series || !persist_exists(SAVED_SERIES_FIRST_PERSIST_KEY)
+        || !prv_persist_read_chunks(SAVED_SERIES_FIRST_PERSIST_KEY, SAVED_SERIES_PERSIST_KEYS, series, sizeof(*series))
+        || series->version != SAVED_SERIES_VERSION || series->count > RECALC_SAVED_INTERVALS) {
+      free(series);
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Recalculation skipped: no saved session");
+      return;
+    }
+    s_recalc.saved = series;
+  } else if (target != RECALC_CURRENT) {
+    return;
+  }
+  s_recalc.target = target;
+  prv_recalc_reset_walk();
+  APP_LOG(APP_LOG_LEVEL_INFO, "Recalculating %s session over %u samples",
+          target == RECALC_SAVED ? "saved" : "current", (unsigned)s_recalc.count);
+  s_recalc.timer = app_timer_register(RECALC_SLICE_MS, prv_recalc_timer_callback, NULL);
+}
+
+// --- Pacer -----------------------------------------------------------------------------------
+// Haptic metronome for the active profile, targeting either a cadence or a pace band. Beat k
+// falls at origin + k * period, computed from k rather than accumulated, so a late timer never
+// shifts the following cues and the beat holds over hours. Only cue beats get a timer: sparse
+// cues while the live cadence is locked on, dense ones while the wearer needs guiding. In pace
+// mode the target cadence comes from the band centre and the stride the wearer is actually
+// taking, so a short stride asks for more steps rather than a wrong pace.
+
+#define PACER_LOCK_PCT 4            // live cadence within this of the target counts as locked
+#define PACER_BAND_PCT 3            // pace band half-width around the profile's target pace
+#define PACER_LOCKED_BEATS 8
+#define PACER_GUIDE_BEATS 2
+#define PACER_RETARGET_SPM 2        // smaller target changes keep the running schedule
+#define PACER_MIN_SPM 60
+#define PACER_MAX_SPM 200
+
+static const uint32_t PACER_LIGHT_SEGMENTS[] = { 30 };
+static const uint32_t PACER_FIRM_SEGMENTS[] = { 70 };
+
+static const VibePattern PACER_LIGHT = {
+  .durations = PACER_LIGHT_SEGMENTS,
+  .num_segments = ARRAY_LENGTH(PACER_LIGHT_SEGMENTS),
+};
+
+static const VibePattern PACER_FIRM = {
+  .durations = PACER_FIRM_SEGMENTS,
+  .num_segments = ARRAY_LENGTH(PACER_FIRM_SEGMENTS),
+};
+
+typedef struct {
+  int32_t target_spm;             // 0 = stopped
+  int64_t period_us;
+  int64_t origin_ms;              // wall time of beat 0
+  int64_t next_beat;              // next cue beat index
+  uint8_t cue_beats;
+  const VibePattern *pattern;
+  AppTimer *timer;
+} Pacer;
+
+static Pacer s_pacer;
+
+static int64_t prv_pacer_deadline_ms(int64_t beat) {
+  return s_pacer.origin_ms + beat * s_pacer.period_us / 1000;
+}
+
+static void prv_pacer_stop(void) {
+  if (s_pacer.timer) {
+    app_timer_cancel(s_pacer.timer);
+    s_pacer.timer = NULL;
+  }
+  s_pacer.target_spm = 0;
+}
+
+static void prv_pacer_timer_callback(void *context);
+
+// Arms the timer for the first cue beat still ahead; beats missed while the app was busy are
+// skipped rather than played late in a burst.
+static void prv_pacer_schedule(int64_t now_ms) {
+  int64_t elapsed_us = (now_ms - s_pacer.origin_ms) * 1000;
+  if (elapsed_us >= 0) {
+    int64_t beat = elapsed_us / s_pacer.period_us + 1;
+    beat += (s_pacer.cue_beats - beat % s_pacer.cue_beats) % s_pacer.cue_beats;
+    if (beat > s_pacer.next_beat) {
+      s_pacer.next_beat = beat;
+    }
+  }
+  int64_t delay_ms = prv_pacer_deadline_ms(s_pacer.next_beat) - now_ms;
+  if (delay_ms * 1000 > s_pacer.period_us * s_pacer.cue_beats * 2) {
+    // The wall clock stepped back; restart the schedule from now.
+    s_pacer.origin_ms = now_ms;
+    s_pacer.next_beat = s_pacer.cue_beats;
+    delay_ms = s_pacer.period_us * s_pacer.cue_beats / 1000;
+  }
+  s_pacer.timer = app_timer_register((uint32_t)(delay_ms > 0 ? delay_ms : 0), prv_pacer_timer_callback, NULL);
+}
+
+static void prv_pacer_timer_callback(void *context) {
+  (void)context;
+  s_pacer.timer = NULL;
+  vibes_enqueue_custom_pattern(*s_pacer.pattern);
+  s_pacer.next_beat += s_pacer.cue_beats;
+  prv_pacer_schedule(prv_clock_wall_ms());
+}
+
+static void prv_pacer_set(int32_t target_spm, uint8_t cue_beats, const VibePattern *pattern) {
+  s_pacer.pattern = pattern;
+  int32_t change = target_spm - s_pacer.target_spm;
+  if (s_pacer.target_spm != 0 && change < PACER_RETARGET_SPM && change > -PACER_RETARGET_SPM
+      && cue_beats == s_pacer.cue_beats) {
+    return;
+  }
+  int64_t now_ms = prv_clock_wall_ms();
+  // A new tempo starts on the beat the old one was about to play, so the rhythm does not stumble.
+  int64_t origin_ms = now_ms;
+  if (s_pacer.timer) {
+    origin_ms = prv_pacer_deadline_ms(s_pacer.next_beat);
+    app_timer_cancel(s_pacer.timer);
+    s_pacer.timer = NULL;
+  }
+  s_pacer.target_spm = target_spm;
+  s_pacer.period_us = 60000000LL / target_spm;
+  s_pacer.origin_ms = origin_ms;
+  s_pacer.cue_beats = cue_beats;
+  s_pacer.next_beat = 0;
+  prv_pacer_schedule(now_ms);
+}
+
+static void prv_pacer_update(int64_t speed_mmps, int32_t cadence_spm) {
+  int32_t profile = prv_active_profile_index();
+  int32_t cadence_target = s_ext_settings.profile_pacer_spm[profile];
+  int32_t pace_target_s = s_ext_settings.profile_pacer_pace_s[profile];
+  if (!prv_session_in_progress() || s_paused || prv_replay_feeding()
+      || (cadence_target <= 0 && pace_target_s <= 0)) {
+    prv_pacer_stop();
+    return;
+  }
+  int32_t target_spm = cadence_target;
+  bool locked = false;
+  if (cadence_target > 0) {
+    int32_t off = cadence_spm - cadence_target;
+    locked = cadence_spm > 0 && (off < 0 ? -off : off) * 100 <= cadence_target * PACER_LOCK_PCT;
+  } else {
+    int64_t target_mmps = 1000000 / pace_target_s;
+    int64_t off_mmps = speed_mmps - target_mmps;
+    locked = cadence_spm > 0 && (off_mmps < 0 ? -off_mmps : off_mmps) * 100 <= target_mmps * PACER_BAND_PCT;
+    int64_t stride_mm = prv_stride_mm(s_stride.profile, cadence_spm);
+    if (cadence_spm > 0 && speed_mmps > 0) {
+      stride_mm = speed_mmps * 60 / cadence_spm;
+    }
+    // Inside the band the wearer's own tempo is the one to hold.
+    target_spm = locked ? cadence_spm : (int32_t)(stride_mm > 0 ? target_mmps * 60 / stride_mm : 0);
+  }
+  if (target_spm < PACER_MIN_SPM) {
+    target_spm = PACER_MIN_SPM;
+  }
+  if (target_spm > PACER_MAX_SPM) {
+    target_spm = PACER_MAX_SPM;
+  }
+  prv_pacer_set(target_spm, locked ? PACER_LOCKED_BEATS : PACER_GUIDE_BEATS, locked ? &PACER_LIGHT : &PACER_FIRM);
+}
+
+static void prv_session_update(time_t now) {
+  // A finished replay stays on screen as it ended; the next session start clears it.
+  if (s_replay.state == REPLAY_DONE) {
+    return;
+  }
+  int64_t active_ms = prv_clock_active_ms();
+  int64_t elapsed_s = active_ms / 1000;
+  if (elapsed_s < 1) {
+    elapsed_s = 1;
+  }
+
+  int32_t steps = 0;
+  int32_t steps_total_day = 0;
+  if (prv_replay_feeding()) {
+    steps = s_replay.steps;
+    steps_total_day = s_steps_baseline + steps;
+  } else {
+    if (s_health_available) {
+      steps_total_day = (int32_t)health_service_sum(HealthMetricStepCount, s_day_start, now);
+      if (steps_total_day < 0) {
+        steps_total_day = 0;
+      }
+    }
+    if (s_settings.sim_steps_enabled) {
+      steps = (int32_t)((elapsed_s * (int64_t)s_settings.sim_steps_spm) / 60);
+      if (s_health_available) {
+        steps_total_day = s_steps_baseline + steps;
+      } else {
+        steps_total_day = steps;
+      }
+    } else if (prv_accel_is_step_source()) {
+      steps = prv_accel_session_steps();
+      if (!s_health_available) {
+        steps_total_day = steps;
+      }
+    } else if (s_health_available) {
+      steps = steps_total_day - s_steps_baseline;
+      if (steps < 0) {
+        steps = 0;
+      }
+      prv_accel_cross_check(now, steps);
+    }
+  }
+
+  prv_auto_pause_update(steps, active_ms);
+
+  if (s_paused) {
+    s_speed_window_ms = -1;
+    s_live.cadence_spm = 0;
+  }
+  if (s_speed_window_ms < 0) {
+    s_speed_window_ms = active_ms;
+    s_last_steps = steps;
+  }
+  int64_t speed_mmps = s_speed_mmps;
+  int64_t window_ms = active_ms - s_speed_window_ms;
+  if (window_ms >= 5000) {
+    int32_t delta_steps = steps - s_last_steps;
+    if (delta_steps < 0) {
       delta_steps = 0;
     }
-    speed_mmps = (int64_t)delta_steps * stride_mm / delta_scaled_s;
-    s_last_time = now;
+    s_live.cadence_spm = (int32_t)((int64_t)delta_steps * 60000 / window_ms);
+    speed_mmps = (int64_t)delta_steps * prv_stride_mm(s_stride.profile, s_live.cadence_spm) * 1000 / window_ms;
+    s_speed_window_ms = active_ms;
     s_last_steps = steps;
     s_speed_mmps = speed_mmps;
   }
   if (speed_mmps > 5000) {
     speed_mmps = 5000;
   }
+  if (s_paused) {
+    prv_stride_rebase(steps);
+  }
+  int64_t distance_mm = prv_stride_advance(steps, s_live.cadence_spm, !prv_replay_feeding());
+
+  // Always track pace in seconds per km for last-activity storage
+  if (distance_mm > 0) {
+    s_session_pace_sec = (int32_t)((elapsed_s * 1000000LL) / distance_mm);
+  }
+
+  int32_t heart_rate_bpm = 0;
+  int64_t grade_q = prv_route_grade_q(distance_mm / 1000);
+  if (prv_replay_feeding()) {
+    heart_rate_bpm = s_replay.heart_rate_bpm;
+    grade_q = s_replay.grade_q;
+  } else if (health_service_metric_accessible(HealthMetricHeartRateBPM, now - 300, now)
+             & HealthServiceAccessibilityMaskAvailable) {
+    heart_rate_bpm = (int32_t)health_service_peek_current_value(HealthMetricHeartRateBPM);
+  }
+
+  int64_t metabolic_mw = s_energy_model->evaluate(&s_energy_params, speed_mmps, grade_q, heart_rate_bpm);
+  int64_t walk_kcal_per_hour = prv_walking_kcal_per_hour(s_energy_params.weight_kg1000, speed_mmps, grade_q);
+  // Integrate whole active seconds; the sub-second remainder stays on the clock for next time.
+  int64_t energy_dt_s = (active_ms - s_energy_last_ms) / 1000;
+  if (energy_dt_s > 0) {
+    s_session_energy_mj += metabolic_mw * energy_dt_s;
+    s_segments.open_energy_mj += metabolic_mw * energy_dt_s;
+    s_session_walk_kcal_s += walk_kcal_per_hour * energy_dt_s;
+    s_energy_last_ms += energy_dt_s * 1000;
+  }
+  int64_t ruck_kcal_total = s_session_energy_mj / 4184000;
+  int64_t walk_kcal_total = s_session_walk_kcal_s / 3600;
 
+  int64_t session_distance_m = distance_mm / 1000;
+  if (session_distance_m < 0) {
+    session_distance_m = 0;
+  }
+  if (session_distance_m > INT32_MAX) {
+    session_distance_m = INT32_MAX;
+  }
+  s_session_distance_m = (int32_t)session_distance_m;
+  if (ruck_kcal_total < 0) {
+    ruck_kcal_total = 0;
+  }
+  if (ruck_kcal_total > INT32_MAX) {
+    ruck_kcal_total = INT32_MAX;
+  }
+  s_session_calories = (int32_t)ruck_kcal_total;
+
+  s_live.steps = steps;
+  s_live.steps_total_day = steps_total_day;
+  s_live.heart_rate_bpm = heart_rate_bpm;
+  s_live.elapsed_s = elapsed_s;
+  s_live.distance_mm = distance_mm;
+  s_live.ruck_kcal_total = ruck_kcal_total;
+  s_live.walk_kcal_total = walk_kcal_total;
+
+  if (!s_paused) {
+    bool grade_from_profile = !prv_replay_feeding() && (s_route.count == 0 || session_distance_m >= s_route.total_m);
+    prv_sampler_update(elapsed_s, speed_mmps, grade_q, grade_from_profile, heart_rate_bpm, ruck_kcal_total);
+    prv_histograms_update(elapsed_s, speed_mmps, grade_q, heart_rate_bpm,
+                          s_energy_params.total_kg1000 - s_energy_params.weight_kg1000);
+    prv_ghost_update(session_distance_m, elapsed_s);
+  }
+  prv_workout_tick(elapsed_s, distance_mm);
+  prv_pacer_update(speed_mmps, s_live.cadence_spm);
+  prv_power_session_update(now, elapsed_s);
+}
+
+static void prv_render_dashboard(time_t now) {
+  if (!s_top_time_layer) {
+    return;
+  }
   bool use_imperial = (s_settings.weight_unit == 1);
   int64_t unit_mm = use_imperial ? 1609344 : 1000000;
   const char *distance_unit_label = use_imperial ? "mi" : "km";
+  int64_t distance_mm = s_live.distance_mm;
+  int64_t elapsed_s = s_live.elapsed_s;
   int64_t distance_x100 = (distance_mm * 100) / unit_mm;
 
   int64_t pace_sec = 0;
   if (distance_mm > 0) {
     pace_sec = (elapsed_s * unit_mm) / distance_mm;
   }
-  // Always track pace in seconds per km for last-activity storage
-  if (distance_mm > 0) {
-    s_session_pace_sec = (int32_t)((elapsed_s * 1000000LL) / distance_mm);
-  }
-
-  ProfileSettings *profile = prv_active_profile();
-  int64_t weight_kg1000 = prv_weight_to_kg1000(s_settings.weight_value, s_settings.weight_unit);
-  int64_t load_kg1000 = prv_weight_to_kg1000(profile->ruck_weight_value, s_settings.ruck_weight_unit);
-  int64_t metabolic_mw = prv_pandolf_metabolic_mw(weight_kg1000, load_kg1000, speed_mmps);
-  int64_t ruck_kcal_per_hour = (metabolic_mw * 3600) / 4184 / 1000;
-  int64_t ruck_kcal_total = (ruck_kcal_per_hour * elapsed_s) / 3600;
-  int64_t walk_kcal_per_hour = prv_walking_kcal_per_hour(weight_kg1000, speed_mmps);
-  int64_t walk_kcal_total = (walk_kcal_per_hour * elapsed_s) / 3600;
 
   static char top_time_buf[16];
   static char distance_buf[16];
@@ -543,78 +3699,424 @@ static void prv_update_display(void) {
   static char calories_walk_value_buf[16];
 
   const char *profile_name = prv_profile_display_name(prv_active_profile_index(), profile_name_buf, sizeof(profile_name_buf));
+  static char workout_buf[24];
+  if (s_paused) {
+    profile_name = s_pause_manual ? "Paused" : "Auto-paused";
+  } else if (s_power.shortfall && now - s_power.shortfall_at < 10) {
+    profile_name = "Battery short";
+  } else if (s_workout.running) {
+    const WorkoutInstr *step = &s_workout.program[s_workout.pc];
+    int64_t remaining_s = s_workout.step_end_s - elapsed_s;
+    if (remaining_s < 0) {
+      remaining_s = 0;
+    }
+    TextBuf text = prv_fmt_begin(workout_buf, sizeof(workout_buf));
+    prv_fmt_uint(&text, s_workout.step_number, 1);
+    prv_fmt_char(&text, '/');
+    prv_fmt_uint(&text, s_workout.step_total, 1);
+    prv_fmt_char(&text, ' ');
+    prv_fmt_str(&text, WORKOUT_INTENSITY_LABELS[step->arg % WORKOUT_INTENSITY_COUNT]);
+    prv_fmt_char(&text, ' ');
+    prv_fmt_mmss(&text, (uint32_t)remaining_s);
+    profile_name = workout_buf;
+  } else if (s_ghost.has_gap) {
+    TextBuf text = prv_fmt_begin(workout_buf, sizeof(workout_buf));
+    prv_fmt_str(&text, "Ghost ");
+    prv_fmt_char(&text, s_ghost.gap_s >= 0 ? '+' : '-');
+    prv_fmt_mmss(&text, (uint32_t)(s_ghost.gap_s >= 0 ? s_ghost.gap_s : -s_ghost.gap_s));
+    profile_name = workout_buf;
+  }
   struct tm *now_tm = localtime(&now);
   if (now_tm) {
     strftime(top_time_buf, sizeof(top_time_buf), clock_is_24h_style() ? "%H:%M" : "%I:%M", now_tm);
   } else {
-    snprintf(top_time_buf, sizeof(top_time_buf), "--:--");
+    strcpy(top_time_buf, "--:--");
   }
-  if (pace_sec > 0) {
-    int pace_min = (int)(pace_sec / 60);
-    int pace_rem = (int)(pace_sec % 60);
-    snprintf(pace_header_buf, sizeof(pace_header_buf), "%d:%02d/%s", pace_min, pace_rem, distance_unit_label);
-    snprintf(pace_value_buf, sizeof(pace_value_buf), "%d:%02d", pace_min, pace_rem);
+  TextBuf text = prv_fmt_begin(pace_value_buf, sizeof(pace_value_buf));
+  if (pace_sec > 0 && pace_sec < INT32_MAX) {
+    prv_fmt_mmss(&text, (uint32_t)pace_sec);
+  } else {
+    prv_fmt_str(&text, "--:--");
+  }
+  text = prv_fmt_begin(distance_buf, sizeof(distance_buf));
+  prv_fmt_fixed(&text, (int32_t)distance_x100, 2, distance_unit_label);
+  text = prv_fmt_begin(timer_value_buf, sizeof(timer_value_buf));
+  prv_fmt_mmss(&text, (uint32_t)elapsed_s);
+  text = prv_fmt_begin(steps_value_buf, sizeof(steps_value_buf));
+  prv_fmt_int(&text, s_live.steps);
+  text = prv_fmt_begin(calories_value_buf, sizeof(calories_value_buf));
+  prv_fmt_int(&text, (int32_t)s_live.ruck_kcal_total);
+  text = prv_fmt_begin(hr_value_buf, sizeof(hr_value_buf));
+  if (s_live.heart_rate_bpm > 0) {
+    prv_fmt_int(&text, s_live.heart_rate_bpm);
   } else {
-    snprintf(pace_header_buf, sizeof(pace_header_buf), "--:--/%s", distance_unit_label);
-    snprintf(pace_value_buf, sizeof(pace_value_buf), "--:--");
-  }
-  snprintf(distance_buf, sizeof(distance_buf), "%ld.%02ld%s",
-           (long)(distance_x100 / 100), (long)labs(distance_x100 % 100), distance_unit_label);
-  snprintf(timer_value_buf, sizeof(timer_value_buf), "%ld:%02ld",
-           (long)(elapsed_s / 60), (long)(elapsed_s % 60));
-  snprintf(steps_value_buf, sizeof(steps_value_buf), "%ld", (long)steps);
-  snprintf(steps_total_value_buf, sizeof(steps_total_value_buf), "%ld", (long)steps_total_day);
-  snprintf(calories_value_buf, sizeof(calories_value_buf), "%ld", (long)ruck_kcal_total);
-  snprintf(calories_walk_value_buf, sizeof(calories_walk_value_buf), "%ld", (long)walk_kcal_total);
+    prv_fmt_str(&text, "--");
+  }
 
-  int64_t session_distance_m = distance_mm / 1000;
-  if (session_distance_m < 0) {
-    session_distance_m = 0;
+  text_layer_set_text(s_top_time_layer, profile_name);
+  text_layer_set_text(s_top_left_layer, top_time_buf);
+  text_layer_set_text(s_top_stats_right_layer, distance_buf);
+  text_layer_set_text(s_mid_left_value_layer, pace_value_buf);
+  text_layer_set_text(s_mid_center_value_layer, hr_value_buf);
+  text_layer_set_text(s_mid_right_value_layer, timer_value_buf);
+  text_layer_set_text(s_bottom_left_value_layer, steps_value_buf);
+  text_layer_set_text(s_bottom_right_value_layer, calories_value_buf);
+
+  // Secondary fields follow the power tier: every tick when allowed, otherwise once a minute.
+  if (s_power.policy->redraw_secondary || now - s_power.secondary_drawn_at >= 60) {
+    s_power.secondary_drawn_at = now;
+    text = prv_fmt_begin(pace_header_buf, sizeof(pace_header_buf));
+    prv_fmt_str(&text, pace_value_buf);
+    prv_fmt_char(&text, '/');
+    prv_fmt_str(&text, distance_unit_label);
+    text = prv_fmt_begin(steps_total_value_buf, sizeof(steps_total_value_buf));
+    prv_fmt_int(&text, s_live.steps_total_day);
+    text = prv_fmt_begin(calories_walk_value_buf, sizeof(calories_walk_value_buf));
+    prv_fmt_int(&text, (int32_t)s_live.walk_kcal_total);
+    text_layer_set_text(s_top_right_layer, pace_header_buf);
+    text_layer_set_text(s_bottom_left_secondary_layer, steps_total_value_buf);
+    text_layer_set_text(s_bottom_right_secondary_layer, calories_walk_value_buf);
+  }
+}
+
+// --- Display wake ----------------------------------------------------------------------------
+// With a wake period configured the dashboard is dormant unless the wearer taps or flicks the
+// wrist: session accounting runs in batches every DISPLAY_DORMANT_TICK_S and the screen is redrawn
+// at most once a minute. A tap, a button press or returning to the dashboard gives live 1 Hz
+// rendering (as far as the power tier allows) for display_wake_s seconds.
+
+#define DISPLAY_DORMANT_TICK_S 15
+#define DISPLAY_DORMANT_RENDER_S 60
+
+typedef struct {
+  bool subscribed;
+  bool awake;
+  AppTimer *wake_timer;
+  time_t rendered_at;
+} DisplayWake;
+
+static DisplayWake s_display;
+
+static bool prv_display_dormant(void) {
+  return s_ext_settings.display_wake_s > 0 && !s_display.awake;
+}
+
+static void prv_update_display(void) {
+  time_t now = prv_session_now();
+  // While a replay runs, its timer drives the session; live ticks only repaint.
+  if (s_replay.state != REPLAY_RUNNING) {
+    prv_session_update(now);
+  }
+  if (!prv_display_dormant() || now - s_display.rendered_at >= DISPLAY_DORMANT_RENDER_S
+      || now < s_display.rendered_at) {
+    s_display.rendered_at = now;
+    prv_render_dashboard(now);
+  }
+  if (s_tick_units != 0) {
+    prv_tick_policy_apply();
+  }
+}
+
+static void prv_tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+  prv_update_display();
+}
+
+static void prv_power_tick_timer_callback(void *context) {
+  (void)context;
+  s_power.tick_timer = NULL;
+  prv_update_display();
+}
+
+// Full-rate ticks only while the session is moving and the power tier allows it; a paused session
+// wakes once a minute for the clock and otherwise waits for health movement events. Intervals
+// between a second and a minute run from an app timer on top of minute ticks.
+static void prv_tick_policy_apply(void) {
+  uint16_t interval_s = s_paused ? 60 : s_power.policy->tick_interval_s;
+  if (prv_display_dormant() && interval_s < DISPLAY_DORMANT_TICK_S) {
+    interval_s = DISPLAY_DORMANT_TICK_S;
+  }
+  TimeUnits units = interval_s <= 1 ? SECOND_UNIT : MINUTE_UNIT;
+  if (units != s_tick_units) {
+    tick_timer_service_subscribe(units, prv_tick_handler);
+    s_tick_units = units;
+  }
+  bool use_timer = interval_s > 1 && interval_s < 60;
+  if (s_power.tick_timer && (!use_timer || s_power.timer_interval_s != interval_s)) {
+    app_timer_cancel(s_power.tick_timer);
+    s_power.tick_timer = NULL;
+  }
+  if (use_timer && !s_power.tick_timer) {
+    s_power.timer_interval_s = interval_s;
+    s_power.tick_timer = app_timer_register(interval_s * 1000, prv_power_tick_timer_callback, NULL);
+  }
+}
+
+static void prv_display_wake_timer_callback(void *context) {
+  (void)context;
+  s_display.wake_timer = NULL;
+  s_display.awake = false;
+  prv_tick_policy_apply();
+}
+
+static void prv_display_wake(void) {
+  if (s_ext_settings.display_wake_s <= 0) {
+    return;
+  }
+  uint32_t wake_ms = (uint32_t)s_ext_settings.display_wake_s * 1000;
+  if (s_display.wake_timer && app_timer_reschedule(s_display.wake_timer, wake_ms)) {
+    return;
+  }
+  s_display.wake_timer = app_timer_register(wake_ms, prv_display_wake_timer_callback, NULL);
+  if (!s_display.awake) {
+    s_display.awake = true;
+    // Catch up on the batch and show it straight away rather than at the next tick.
+    s_display.rendered_at = 0;
+    prv_update_display();
+  }
+}
+
+static void prv_display_tap_handler(AccelAxisType axis, int32_t direction) {
+  (void)axis;
+  (void)direction;
+  prv_display_wake();
+}
+
+static void prv_display_apply_policy(void) {
+  bool want = s_ext_settings.display_wake_s > 0;
+  if (want != s_display.subscribed) {
+    if (want) {
+      accel_tap_service_subscribe(prv_display_tap_handler);
+    } else {
+      accel_tap_service_unsubscribe();
+    }
+    s_display.subscribed = want;
+  }
+  if (!want) {
+    if (s_display.wake_timer) {
+      app_timer_cancel(s_display.wake_timer);
+      s_display.wake_timer = NULL;
+    }
+    s_display.awake = false;
+  }
+  if (s_tick_units != 0) {
+    prv_tick_policy_apply();
+  }
+}
+
+static void prv_health_handler(HealthEventType event, void *context) {
+  if (event == HealthEventMovementUpdate || event == HealthEventSignificantUpdate) {
+    // A moving, dormant session catches up at its next batch; a paused one still wakes here.
+    if (prv_display_dormant() && !s_paused) {
+      return;
+    }
+    prv_update_display();
+  }
+}
+
+static void prv_replay_stop(void) {
+  if (s_replay.timer) {
+    app_timer_cancel(s_replay.timer);
+    s_replay.timer = NULL;
+  }
+  s_replay.state = REPLAY_IDLE;
+  prv_clock_set_source(NULL);
+}
+
+static void prv_start_session(void) {
+  prv_replay_stop();
+  prv_clock_sync_scale();
+  prv_clock_start(0, false);
+  s_start_time = prv_session_now();
+  s_speed_window_ms = -1;
+  s_last_steps = 0;
+  s_speed_mmps = 0;
+  s_session_distance_m = 0;
+  s_session_calories = 0;
+  s_session_totals_committed = false;
+  s_energy_last_ms = 0;
+  s_session_energy_mj = 0;
+  s_session_walk_kcal_s = 0;
+  s_paused = false;
+  s_pause_manual = false;
+  s_motion_last_steps = 0;
+  s_motion_last_ms = 0;
+  s_live.elapsed_s = 0;
+  s_live.distance_mm = 0;
+  s_power.checkpoint_at = 0;
+  prv_accel_mark_session_start();
+  prv_sampler_reset(0);
+  prv_histograms_reset((int32_t)s_start_time, 0);
+  prv_ghost_start((uint8_t)prv_active_profile_index(), true);
+  prv_stride_start((uint8_t)prv_active_profile_index(), 0, 0, true);
+  prv_energy_model_refresh();
+  prv_recalc_baseline_capture();
+  prv_segments_reset();
+  prv_workout_start(0, 0);
+  if (s_health_available) {
+    s_steps_baseline = (int32_t)health_service_sum(HealthMetricStepCount, s_day_start, s_start_time);
+  } else {
+    s_steps_baseline = 0;
+  }
+}
+
+// --- Trace replay ----------------------------------------------------------------------------
+// Feeds recorded or synthetic traces through prv_session_update one virtual second at a time, so
+// replays exercise exactly the live accounting path at any speed-up.
+
+static bool prv_replay_read_record(uint16_t index, ReplayRecord *out) {
+  if (index >= s_replay.record_count) {
+    return false;
+  }
+  if (s_replay.source == REPLAY_SOURCE_UPLOADED) {
+    *out = s_replay.uploaded[index];
+    return true;
+  }
+  ResHandle handle = resource_get_handle(RESOURCE_ID_TRACE_LONG_RUCK);
+  return resource_load_byte_range(handle, (uint32_t)index * sizeof(ReplayRecord),
+                                  (uint8_t *)out, sizeof(ReplayRecord)) == sizeof(ReplayRecord);
+}
+
+static void prv_replay_finish(void) {
+  s_replay.state = REPLAY_DONE;
+  prv_clock_set_source(NULL);
+  prv_clock_sync_scale();
+  s_replay.heart_rate_bpm = 0;
+  uint32_t us_per_tick = s_replay.ticks ? (s_replay.busy_ms * 1000) / s_replay.ticks : 0;
+  APP_LOG(APP_LOG_LEVEL_INFO, "Replay done: %lu/%lu s, %lu ticks, %lu us/tick, max slice %lu ms",
+          (unsigned long)(prv_session_now() - s_start_time), (unsigned long)s_replay.expected_duration_s,
+          (unsigned long)s_replay.ticks, (unsigned long)us_per_tick, (unsigned long)s_replay.max_slice_ms);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Replay totals: steps %ld/%ld, %ld m, %ld kcal, walk %ld kcal",
+          (long)s_live.steps, (long)s_replay.expected_steps, (long)s_session_distance_m,
+          (long)s_session_calories, (long)s_live.walk_kcal_total);
+}
+
+static int64_t prv_replay_clock_ms(void) {
+  return s_replay.virtual_ms;
+}
+
+// Advances the trace by one virtual second; returns false once the trace is exhausted.
+static bool prv_replay_advance_second(void) {
+  while (s_replay.record_elapsed_s >= s_replay.record.duration_s) {
+    if (!prv_replay_read_record(s_replay.record_index, &s_replay.record)) {
+      return false;
+    }
+    s_replay.record_index++;
+    s_replay.record_elapsed_s = 0;
   }
-  if (session_distance_m > INT32_MAX) {
-    session_distance_m = INT32_MAX;
+  int32_t step_q = s_replay.step_remainder + s_replay.record.cadence_spm;
+  s_replay.steps += step_q / 60;
+  s_replay.step_remainder = step_q % 60;
+  s_replay.heart_rate_bpm = s_replay.record.heart_rate_bpm;
+  s_replay.grade_q = (int64_t)s_replay.record.grade_tenths * 10;
+  s_replay.record_elapsed_s++;
+  s_replay.virtual_ms += 1000;
+  return true;
+}
+
+static void prv_replay_timer_callback(void *context) {
+  (void)context;
+  s_replay.timer = NULL;
+  s_replay.debt_ms += s_replay.speed * REPLAY_SLICE_MS;
+  uint32_t seconds = s_replay.debt_ms / 1000;
+  s_replay.debt_ms %= 1000;
+
+  int64_t slice_start_ms = prv_clock_wall_ms();
+  bool more = true;
+  for (uint32_t i = 0; i < seconds; ++i) {
+    more = prv_replay_advance_second();
+    if (!more) {
+      break;
+    }
+    prv_session_update(prv_session_now());
+    s_replay.ticks++;
   }
-  s_session_distance_m = (int32_t)session_distance_m;
-  if (ruck_kcal_total < 0) {
-    ruck_kcal_total = 0;
+  uint32_t slice_ms = (uint32_t)(prv_clock_wall_ms() - slice_start_ms);
+  s_replay.busy_ms += slice_ms;
+  if (slice_ms > s_replay.max_slice_ms) {
+    s_replay.max_slice_ms = slice_ms;
   }
-  if (ruck_kcal_total > INT32_MAX) {
-    ruck_kcal_total = INT32_MAX;
+
+  if (more) {
+    s_replay.timer = app_timer_register(REPLAY_SLICE_MS, prv_replay_timer_callback, NULL);
+  } else {
+    prv_replay_finish();
   }
-  s_session_calories = (int32_t)ruck_kcal_total;
+  prv_render_dashboard(prv_session_now());
+}
 
-  if (health_service_metric_accessible(HealthMetricHeartRateBPM, now - 300, now)
-      & HealthServiceAccessibilityMaskAvailable) {
-    HealthValue heart_rate = health_service_peek_current_value(HealthMetricHeartRateBPM);
-    if (heart_rate > 0) {
-      snprintf(hr_value_buf, sizeof(hr_value_buf), "%ld", (long)heart_rate);
-    } else {
-      snprintf(hr_value_buf, sizeof(hr_value_buf), "--");
-    }
+static void prv_replay_start(ReplaySource source, uint32_t speed) {
+  uint16_t count = 0;
+  if (source == REPLAY_SOURCE_UPLOADED) {
+    count = s_replay.uploaded ? s_replay.uploaded_count : 0;
   } else {
-    snprintf(hr_value_buf, sizeof(hr_value_buf), "--");
+    size_t bytes = resource_size(resource_get_handle(RESOURCE_ID_TRACE_LONG_RUCK));
+    count = (uint16_t)(bytes / sizeof(ReplayRecord));
+  }
+  if (count == 0) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Replay source %d has no records", (int)source);
+    return;
   }
 
-  text_layer_set_text(s_top_time_layer, profile_name);
-  text_layer_set_text(s_top_left_layer, top_time_buf);
-  text_layer_set_text(s_top_right_layer, pace_header_buf);
-  text_layer_set_text(s_top_stats_right_layer, distance_buf);
-  text_layer_set_text(s_mid_left_value_layer, pace_value_buf);
-  text_layer_set_text(s_mid_center_value_layer, hr_value_buf);
-  text_layer_set_text(s_mid_right_value_layer, timer_value_buf);
-  text_layer_set_text(s_bottom_left_value_layer, steps_value_buf);
-  text_layer_set_text(s_bottom_left_secondary_layer, steps_total_value_buf);
-  text_layer_set_text(s_bottom_right_value_layer, calories_value_buf);
-  text_layer_set_text(s_bottom_right_secondary_layer, calories_walk_value_buf);
-}
+  prv_start_session();
+  s_replay.source = source;
+  s_replay.record_count = count;
+  s_replay.record_index = 0;
+  s_replay.record_elapsed_s = 0;
+  memset(&s_replay.record, 0, sizeof(s_replay.record));
+  s_replay.speed = speed > 0 ? speed : 1;
+  s_replay.debt_ms = 0;
+  s_replay.virtual_ms = 0;
+  s_replay.steps = 0;
+  s_replay.step_remainder = 0;
+  s_replay.heart_rate_bpm = 0;
+  s_replay.grade_q = 0;
+  s_replay.ticks = 0;
+  s_replay.busy_ms = 0;
+  s_replay.max_slice_ms = 0;
 
-static void prv_tick_handler(struct tm *tick_time, TimeUnits units_changed) {
-  prv_update_display();
+  // Exact totals for the drift check at the end.
+  int64_t step_q_total = 0;
+  uint32_t duration_total = 0;
+  ReplayRecord record;
+  for (uint16_t i = 0; i < count; ++i) {
+    if (prv_replay_read_record(i, &record)) {
+      step_q_total += (int64_t)record.cadence_spm * record.duration_s;
+      duration_total += record.duration_s;
+    }
+  }
+  s_replay.expected_steps = step_q_total / 60;
+  s_replay.expected_duration_s = duration_total;
+
+  s_replay.state = REPLAY_RUNNING;
+  prv_clock_set_source(prv_replay_clock_ms);
+  prv_clock_sync_scale();
+  s_replay.timer = app_timer_register(REPLAY_SLICE_MS, prv_replay_timer_callback, NULL);
+  APP_LOG(APP_LOG_LEVEL_INFO, "Replay started: %u records, %lu s, x%lu",
+          (unsigned)count, (unsigned long)duration_total, (unsigned long)s_replay.speed);
 }
 
-static void prv_health_handler(HealthEventType event, void *context) {
-  if (event == HealthEventMovementUpdate || event == HealthEventSignificantUpdate) {
-    prv_update_display();
+// Traces from the phone arrive in chunks of whole records; offset 0 starts a new trace.
+static void prv_replay_receive_chunk(int32_t offset_records, const uint8_t *data, uint16_t length) {
+  if (offset_records == 0) {
+    if (s_replay.state == REPLAY_RUNNING && s_replay.source == REPLAY_SOURCE_UPLOADED) {
+      prv_replay_stop();
+    }
+    if (!s_replay.uploaded) {
+      prv_icon_cache_trim();
+      s_replay.uploaded = malloc(REPLAY_MAX_RECORDS * sizeof(ReplayRecord));
+    }
+    s_replay.uploaded_count = 0;
+  }
+  if (!s_replay.uploaded || offset_records < 0 || offset_records >= REPLAY_MAX_RECORDS) {
+    return;
+  }
+  uint32_t count = length / sizeof(ReplayRecord);
+  if ((uint32_t)offset_records + count > REPLAY_MAX_RECORDS) {
+    count = REPLAY_MAX_RECORDS - (uint32_t)offset_records;
+  }
+  memcpy(&s_replay.uploaded[offset_records], data, count * sizeof(ReplayRecord));
+  if (offset_records + count > s_replay.uploaded_count) {
+    s_replay.uploaded_count = (uint16_t)(offset_records + count);
   }
 }
 
@@ -701,9 +4203,96 @@ static void prv_inbox_received_handler(DictionaryIterator *iter, void *context)
   if (t && t->type == TUPLE_CSTRING) {
     prv_set_profile_name(2, t->value->cstring);
   }
+  t = dict_find(iter, MESSAGE_KEY_profile1_energy_model);
+  if (t) {
+    s_ext_settings.profile_energy_models[0] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile2_energy_model);
+  if (t) {
+    s_ext_settings.profile_energy_models[1] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile3_energy_model);
+  if (t) {
+    s_ext_settings.profile_energy_models[2] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile1_pacer_spm);
+  if (t) {
+    s_ext_settings.profile_pacer_spm[0] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile1_pacer_pace_s);
+  if (t) {
+    s_ext_settings.profile_pacer_pace_s[0] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile2_pacer_spm);
+  if (t) {
+    s_ext_settings.profile_pacer_spm[1] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile2_pacer_pace_s);
+  if (t) {
+    s_ext_settings.profile_pacer_pace_s[1] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile3_pacer_spm);
+  if (t) {
+    s_ext_settings.profile_pacer_spm[2] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_profile3_pacer_pace_s);
+  if (t) {
+    s_ext_settings.profile_pacer_pace_s[2] = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_age_years);
+  if (t) {
+    s_ext_settings.age_years = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_sex);
+  if (t) {
+    s_ext_settings.sex = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_auto_pause_seconds);
+  if (t) {
+    s_ext_settings.auto_pause_seconds = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_planned_duration_min);
+  if (t) {
+    s_ext_settings.planned_duration_min = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_step_source);
+  if (t) {
+    s_ext_settings.step_source = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_accel_threshold_mg);
+  if (t) {
+    s_ext_settings.accel_threshold_mg = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_accel_min_step_ms);
+  if (t) {
+    s_ext_settings.accel_min_step_ms = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_display_wake_s);
+  if (t) {
+    s_ext_settings.display_wake_s = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_ghost_mode);
+  if (t) {
+    s_ext_settings.ghost_mode = t->value->int32;
+  }
+  t = dict_find(iter, MESSAGE_KEY_route_segments);
+  if (t && t->type == TUPLE_BYTE_ARRAY) {
+    Tuple *profile = dict_find(iter, MESSAGE_KEY_route_profile);
+    prv_route_store(profile ? profile->value->int32 : -1, t->value->data, t->length);
+  }
+  t = dict_find(iter, MESSAGE_KEY_stride_table);
+  if (t && t->type == TUPLE_BYTE_ARRAY) {
+    Tuple *profile = dict_find(iter, MESSAGE_KEY_stride_profile);
+    prv_stride_tables_store(profile ? profile->value->int32 : -1, t->value->data, t->length);
+  }
+  t = dict_find(iter, MESSAGE_KEY_workout_program);
+  if (t && t->type == TUPLE_BYTE_ARRAY) {
+    prv_workout_set_program(t->value->data, t->length, true);
+  }
   t = dict_find(iter, MESSAGE_KEY_sim_steps_enabled);
   if (t) {
     s_settings.sim_steps_enabled = t->value->int32;
+    prv_clock_sync_scale();
   }
   t = dict_find(iter, MESSAGE_KEY_sim_steps_spm);
   if (t) {
@@ -711,10 +4300,29 @@ static void prv_inbox_received_handler(DictionaryIterator *iter, void *context)
   }
   t = dict_find(iter, MESSAGE_KEY_request_lifetime_totals);
   if (t && t->value->int32 == 1) {
-    prv_send_lifetime_totals();
+    prv_outbox_enqueue(OUTBOX_MSG_TOTALS);
+  }
+  t = dict_find(iter, MESSAGE_KEY_replay_trace_chunk);
+  if (t && t->type == TUPLE_BYTE_ARRAY) {
+    Tuple *offset = dict_find(iter, MESSAGE_KEY_replay_trace_offset);
+    prv_replay_receive_chunk(offset ? offset->value->int32 : 0, t->value->data, t->length);
+  }
+  t = dict_find(iter, MESSAGE_KEY_replay_start);
+  if (t && t->value->int32 != 0) {
+    Tuple *speed = dict_find(iter, MESSAGE_KEY_replay_speed);
+    prv_replay_start((ReplaySource)t->value->int32, speed ? (uint32_t)speed->value->int32 : 60);
   }
 
   prv_save_settings();
+  prv_energy_model_refresh();
+  prv_profile_rows_rebuild();
+  prv_accel_apply_policy();
+  prv_display_apply_policy();
+  // Runs against the settings applied above.
+  t = dict_find(iter, MESSAGE_KEY_recalculate);
+  if (t && t->value->int32 != RECALC_NONE) {
+    prv_recalc_start((RecalcTarget)t->value->int32);
+  }
   APP_LOG(APP_LOG_LEVEL_INFO, "Config applied: active_profile=%ld", (long)s_settings.active_profile);
   if (s_profile_menu_layer) {
     menu_layer_reload_data(s_profile_menu_layer);
@@ -727,27 +4335,6 @@ static void prv_inbox_dropped_handler(AppMessageResult reason, void *context) {
   APP_LOG(APP_LOG_LEVEL_ERROR, "Inbox dropped: %d", (int)reason);
 }
 
-static void prv_outbox_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
-  (void)failed;
-  (void)context;
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox failed: %d", (int)reason);
-}
-
-static void prv_start_session(void) {
-  s_start_time = time(NULL);
-  s_last_time = 0;
-  s_last_steps = 0;
-  s_speed_mmps = 0;
-  s_session_distance_m = 0;
-  s_session_calories = 0;
-  s_session_totals_committed = false;
-  if (s_health_available) {
-    s_steps_baseline = (int32_t)health_service_sum(HealthMetricStepCount, s_day_start, s_start_time);
-  } else {
-    s_steps_baseline = 0;
-  }
-}
-
 static uint16_t prv_profile_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *context) {
   (void)menu_layer;
   (void)section_index;
@@ -762,101 +4349,170 @@ static int16_t prv_profile_get_cell_height_callback(MenuLayer *menu_layer, MenuI
   return s_profile_cell_height;
 }
 
-static void prv_profile_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *context) {
-  (void)context;
-  int row = (int)cell_index->row;
-  if (row >= PROFILE_COUNT) {
-    return;
-  }
-  ProfileSettings *p = &s_settings.profiles[row];
-  static char legacy_title[16];
-  static char weight_value[12];
-  static char terrain_value[12];
-  static char grade_value[8];
-  const char *title_text = legacy_title;
-  const char *weight_unit = (s_settings.ruck_weight_unit == 1) ? "lb" : "kg";
+// Row geometry depends only on the cell size and icon bounds; rebuilt when either changes.
+typedef struct {
+  bool valid;
+  GSize row_size;
+  GRect separator;
+  GRect title;
+  GRect weight_icon;
+  GRect terrain_icon;
+  GRect grade_icon;
+  GRect weight_text;
+  GRect terrain_text;
+  GRect grade_text;
+} ProfileRowLayout;
+
+static ProfileRowLayout s_profile_row_layout;
+
+static GSize prv_icon_size(GBitmap *icon) {
+  return icon ? gbitmap_get_bounds(icon).size : GSize(0, 0);
+}
+
+static void prv_profile_row_layout_build(GSize row_size) {
+  ProfileRowLayout *layout = &s_profile_row_layout;
   const int16_t y = 0;
-  GRect bounds = layer_get_bounds((Layer *)cell_layer);
-  const int16_t row_w = bounds.size.w;
-  const int16_t row_h = bounds.size.h;
   const int16_t content_x = SCREEN_PADDING;
-  const int16_t content_w = row_w - (2 * SCREEN_PADDING);
-  const int16_t value_y = row_h - 32;
+  const int16_t content_w = row_size.w - (2 * SCREEN_PADDING);
+  const int16_t value_y = row_size.h - 32;
   const int16_t icon_y = y + value_y + 2;
-  const int16_t weight_icon_w = s_profile_weight_icon ? gbitmap_get_bounds(s_profile_weight_icon).size.w : 0;
-  const int16_t weight_icon_h = s_profile_weight_icon ? gbitmap_get_bounds(s_profile_weight_icon).size.h : 0;
-  const int16_t terrain_icon_w = s_profile_terrain_icon ? gbitmap_get_bounds(s_profile_terrain_icon).size.w : 0;
-  const int16_t terrain_icon_h = s_profile_terrain_icon ? gbitmap_get_bounds(s_profile_terrain_icon).size.h : 0;
-  const int16_t grade_icon_w = s_profile_grade_icon ? gbitmap_get_bounds(s_profile_grade_icon).size.w : 0;
-  const int16_t grade_icon_h = s_profile_grade_icon ? gbitmap_get_bounds(s_profile_grade_icon).size.h : 0;
-  const int16_t grade_col_w = grade_icon_w + 2 + PROFILE_GRADE_TEXT_WIDTH;
+  const GSize weight_icon = prv_icon_size(s_profile_weight_icon);
+  const GSize terrain_icon = prv_icon_size(s_profile_terrain_icon);
+  const GSize grade_icon = prv_icon_size(s_profile_grade_icon);
+  const int16_t grade_col_w = grade_icon.w + 2 + PROFILE_GRADE_TEXT_WIDTH;
   const int16_t remaining_w = content_w - grade_col_w;
   const int16_t weight_col_x = content_x;
   const int16_t weight_col_w = (remaining_w / 2) - (PROFILE_TERRAIN_BONUS_WIDTH / 2);
   const int16_t terrain_col_x = weight_col_x + weight_col_w;
   const int16_t terrain_col_w = remaining_w - weight_col_w;
   const int16_t grade_col_x = terrain_col_x + terrain_col_w;
+
+  layout->row_size = row_size;
+  layout->separator = GRect(content_x, 0, content_w, 1);
+  layout->title = GRect(content_x, y + 2, content_w, 24);
+  layout->weight_icon = GRect(weight_col_x, icon_y, weight_icon.w, weight_icon.h);
+  layout->terrain_icon = GRect(terrain_col_x, icon_y, terrain_icon.w, terrain_icon.h);
+  layout->grade_icon = GRect(grade_col_x, icon_y, grade_icon.w, grade_icon.h);
+  layout->weight_text = GRect(weight_col_x + weight_icon.w + 2, y + value_y + 5,
+                              weight_col_w - (weight_icon.w + 2), 22);
+  layout->terrain_text = GRect(terrain_col_x + terrain_icon.w + 2, y + value_y + 5,
+                               terrain_col_w - (terrain_icon.w + 2), 22);
+  layout->grade_text = GRect(grade_col_x + grade_icon.w + 2, y + value_y + 5,
+                             grade_col_w - (grade_icon.w + 2), 22);
+  layout->valid = true;
+}
+
+static void prv_profile_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *context) {
+  (void)context;
+  int row = (int)cell_index->row;
+  if (row >= PROFILE_COUNT) {
+    return;
+  }
+  GRect bounds = layer_get_bounds((Layer *)cell_layer);
+  const ProfileRowLayout *layout = &s_profile_row_layout;
+  if (!layout->valid || layout->row_size.w != bounds.size.w || layout->row_size.h != bounds.size.h) {
+    prv_profile_row_layout_build(bounds.size);
+  }
+  const ProfileRowModel *model = &s_profile_rows[row];
   const GFont title_font = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
   const GFont value_font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
   bool is_highlighted = menu_cell_layer_is_highlighted(cell_layer);
   GColor bg = is_highlighted ? GColorWhite : GColorBlack;
   GColor fg = is_highlighted ? GColorBlack : GColorWhite;
 
-  title_text = prv_profile_display_name(row, legacy_title, sizeof(legacy_title));
-  snprintf(weight_value, sizeof(weight_value), "%ld.%ld%s",
-           (long)(p->ruck_weight_value / 10), (long)labs(p->ruck_weight_value % 10), weight_unit);
-  snprintf(terrain_value, sizeof(terrain_value), "%s", prv_profile_terrain_label(row, p->terrain_factor));
-  int32_t grade_int = (p->grade_percent >= 0) ? ((p->grade_percent + 5) / 10) : ((p->grade_percent - 5) / 10);
-  snprintf(grade_value, sizeof(grade_value), "%ld%%", (long)grade_int);
-
   graphics_context_set_fill_color(ctx, bg);
   graphics_fill_rect(ctx, bounds, 0, GCornerNone);
   if (row > 0) {
+    const GRect sep = layout->separator;
     graphics_context_set_stroke_color(ctx, is_highlighted ? GColorLightGray : GColorDarkGray);
-    graphics_draw_line(ctx, GPoint(content_x, 0), GPoint(content_x + content_w - 1, 0));
+    graphics_draw_line(ctx, sep.origin, GPoint(sep.origin.x + sep.size.w - 1, sep.origin.y));
   }
   graphics_context_set_text_color(ctx, fg);
-  graphics_draw_text(ctx, title_text, title_font, GRect(content_x, y + 2, content_w, 24),
+  graphics_draw_text(ctx, model->title, title_font, layout->title,
                      GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
 
   if (is_highlighted) {
     // Keep icon contrast on the white selected row.
     graphics_context_set_fill_color(ctx, GColorBlack);
     if (s_profile_weight_icon) {
-      graphics_fill_rect(ctx, GRect(weight_col_x, icon_y, weight_icon_w, weight_icon_h), 3, GCornersAll);
+      graphics_fill_rect(ctx, layout->weight_icon, 3, GCornersAll);
     }
     if (s_profile_terrain_icon) {
-      graphics_fill_rect(ctx, GRect(terrain_col_x, icon_y, terrain_icon_w, terrain_icon_h), 3, GCornersAll);
+      graphics_fill_rect(ctx, layout->terrain_icon, 3, GCornersAll);
     }
     if (s_profile_grade_icon) {
-      graphics_fill_rect(ctx, GRect(grade_col_x, icon_y, grade_icon_w, grade_icon_h), 3, GCornersAll);
+      graphics_fill_rect(ctx, layout->grade_icon, 3, GCornersAll);
     }
   }
   graphics_context_set_compositing_mode(ctx, GCompOpSet);
   if (s_profile_weight_icon) {
-    graphics_draw_bitmap_in_rect(ctx, s_profile_weight_icon, GRect(weight_col_x, icon_y, weight_icon_w, weight_icon_h));
+    graphics_draw_bitmap_in_rect(ctx, s_profile_weight_icon, layout->weight_icon);
   }
   if (s_profile_terrain_icon) {
-    graphics_draw_bitmap_in_rect(ctx, s_profile_terrain_icon, GRect(terrain_col_x, icon_y, terrain_icon_w, terrain_icon_h));
+    graphics_draw_bitmap_in_rect(ctx, s_profile_terrain_icon, layout->terrain_icon);
   }
   if (s_profile_grade_icon) {
-    graphics_draw_bitmap_in_rect(ctx, s_profile_grade_icon, GRect(grade_col_x, icon_y, grade_icon_w, grade_icon_h));
+    graphics_draw_bitmap_in_rect(ctx, s_profile_grade_icon, layout->grade_icon);
   }
-  graphics_draw_text(ctx, weight_value, value_font, GRect(weight_col_x + weight_icon_w + 2, y + value_y + 5, weight_col_w - (weight_icon_w + 2), 22),
+  graphics_draw_text(ctx, model->weight, value_font, layout->weight_text,
                      GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
-  graphics_draw_text(ctx, terrain_value, value_font, GRect(terrain_col_x + terrain_icon_w + 2, y + value_y + 5, terrain_col_w - (terrain_icon_w + 2), 22),
+  graphics_draw_text(ctx, model->terrain, value_font, layout->terrain_text,
                      GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
-  graphics_draw_text(ctx, grade_value, value_font, GRect(grade_col_x + grade_icon_w + 2, y + value_y + 5, grade_col_w - (grade_icon_w + 2), 22),
+  graphics_draw_text(ctx, model->grade, value_font, layout->grade_text,
                      GTextOverflowModeTrailingEllipsis, GTextAlignmentRight, NULL);
 }
 
+// Closes the open segment at the current totals and continues the session under another profile.
+// Declined once every segment slot is used.
+static void prv_session_switch_profile(int32_t profile_index) {
+  if (profile_index == prv_active_profile_index()) {
+    return;
+  }
+  if (prv_segments_full()) {
+    // No slot left to attribute the new profile's time to; the wearer can bank and start fresh.
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Segment limit reached, staying on profile %ld",
+            (long)prv_active_profile_index() + 1);
+    vibes_double_pulse();
+    return;
+  }
+  prv_session_update(prv_session_now());
+  prv_segment_close();
+  s_settings.active_profile = profile_index;
+  prv_save_settings();
+  prv_energy_model_refresh();
+  prv_segment_open();
+  prv_ghost_stop();
+  prv_stride_switch_profile((uint8_t)profile_index);
+  s_power.checkpoint_at = 0;
+}
+
 static void prv_profile_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *context) {
   (void)menu_layer;
   (void)context;
   if (cell_index->row >= PROFILE_COUNT) {
     return;
   }
-  s_settings.active_profile = cell_index->row;
+  if (prv_session_in_progress()) {
+    prv_session_switch_profile(cell_index->row);
+  } else {
+    s_settings.active_profile = cell_index->row;
+    prv_save_settings();
+    prv_start_session();
+  }
+  window_stack_remove(s_profile_window, true);
+  prv_update_display();
+}
+
+// Long select on a profile banks the running session and starts a fresh one.
+static void prv_profile_select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  (void)recognizer;
+  (void)context;
+  MenuIndex selected = menu_layer_get_selected_index(s_profile_menu_layer);
+  if (selected.row >= PROFILE_COUNT) {
+    return;
+  }
+  prv_commit_session_totals("new session");
+  s_settings.active_profile = selected.row;
   prv_save_settings();
   prv_start_session();
   window_stack_remove(s_profile_window, true);
@@ -902,6 +4558,7 @@ static void prv_profile_click_config_provider(void *context) {
   window_single_click_subscribe(BUTTON_ID_UP, prv_profile_up_click_handler);
   window_single_click_subscribe(BUTTON_ID_DOWN, prv_profile_down_click_handler);
   window_single_click_subscribe(BUTTON_ID_SELECT, prv_profile_select_click_handler);
+  window_long_click_subscribe(BUTTON_ID_SELECT, 500, prv_profile_select_long_click_handler, NULL);
 }
 
 static void prv_main_back_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -913,6 +4570,8 @@ static void prv_main_back_click_handler(ClickRecognizerRef recognizer, void *con
   }
 }
 
+static void prv_status_timer_callback(void *context);
+
 static void prv_main_down_click_handler(ClickRecognizerRef recognizer, void *context) {
   (void)recognizer;
   (void)context;
@@ -920,7 +4579,7 @@ static void prv_main_down_click_handler(ClickRecognizerRef recognizer, void *con
   s_last_activity_distance_m = s_session_distance_m;
   s_last_activity_calories   = s_session_calories;
   s_last_activity_pace_sec   = s_session_pace_sec;
-  s_last_activity_timestamp  = (int32_t)time(NULL);
+  s_last_activity_timestamp  = (int32_t)prv_session_now();
   persist_write_int(LAST_ACTIVITY_DISTANCE_M_PERSIST_KEY, s_last_activity_distance_m);
   persist_write_int(LAST_ACTIVITY_CALORIES_PERSIST_KEY,   s_last_activity_calories);
   persist_write_int(LAST_ACTIVITY_PACE_SEC_PERSIST_KEY,   s_last_activity_pace_sec);
@@ -982,6 +4641,259 @@ static void prv_music_window_unload(Window *window) {
   s_music_menu_layer = NULL;
 }
 
+static uint16_t prv_stats_get_num_sections_callback(MenuLayer *menu_layer, void *context) {
+  (void)menu_layer;
+  (void)context;
+  return 3;
+}
+
+static uint16_t prv_stats_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *context) {
+  (void)menu_layer;
+  (void)context;
+  if (section_index == 0) {
+    return 2;
+  }
+  return section_index == 1 ? ROLLUP_WEEKS : ROLLUP_MONTHS;
+}
+
+static int16_t prv_stats_get_header_height_callback(MenuLayer *menu_layer, uint16_t section_index, void *context) {
+  (void)menu_layer;
+  (void)section_index;
+  (void)context;
+  return MENU_CELL_BASIC_HEADER_HEIGHT;
+}
+
+static void prv_stats_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *context) {
+  (void)context;
+  static const char *k_headers[] = { "Last session", "Weekly", "Monthly" };
+  menu_cell_basic_header_draw(ctx, cell_layer, k_headers[section_index % 3]);
+}
+
+// The two heart-rate zones the last session spent longest in, read straight off its histogram.
+static void prv_stats_draw_zones_row(GContext *ctx, const Layer *cell_layer) {
+  const SessionHistograms *hist = &s_last_histograms;
+  uint8_t first = 0;
+  uint8_t second = 0;
+  uint32_t first_s = 0;
+  uint32_t second_s = 0;
+  for (uint8_t zone = 1; zone < HIST_HR_BINS; ++zone) {
+    uint32_t zone_s = hist->hr_zone_s[zone];
+    if (zone_s > first_s) {
+      second = first;
+      second_s = first_s;
+      first = zone;
+      first_s = zone_s;
+    } else if (zone_s > second_s) {
+      second = zone;
+      second_s = zone_s;
+    }
+  }
+  if (hist->version != HISTOGRAMS_VERSION || first == 0) {
+    menu_cell_basic_draw(ctx, cell_layer, "HR zones", "No heart rate", NULL);
+    return;
+  }
+  char subtitle[24];
+  TextBuf text = prv_fmt_begin(subtitle, sizeof(subtitle));
+  prv_fmt_char(&text, 'Z');
+  prv_fmt_uint(&text, first, 1);
+  prv_fmt_char(&text, ' ');
+  prv_fmt_hmmss(&text, first_s);
+  if (second != 0) {
+    prv_fmt_str(&text, ", Z");
+    prv_fmt_uint(&text, second, 1);
+    prv_fmt_char(&text, ' ');
+    prv_fmt_hmmss(&text, second_s);
+  }
+  menu_cell_basic_draw(ctx, cell_layer, "HR zones", subtitle, NULL);
+}
+
+static void prv_stats_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *context) {
+  (void)context;
+  static const char *k_months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+  if (cell_index->section == 0 && cell_index->row == 1) {
+    prv_stats_draw_zones_row(ctx, cell_layer);
+    return;
+  }
+  if (cell_index->section == 0) {
+    SessionHistory *history = prv_history_get();
+    char subtitle[24];
+    if (!history) {
+      menu_cell_basic_draw(ctx, cell_layer, "Charts", "No saved session", NULL);
+      return;
+    }
+    time_t start = (time_t)history->start_time;
+    struct tm *start_tm = localtime(&start);
+    snprintf(subtitle, sizeof(subtitle), "%d %s, %ld:%02ldh",
+             start_tm ? start_tm->tm_mday : 0, k_months[start_tm ? start_tm->tm_mon % 12 : 0],
+             (long)(history->duration_s / 3600), (long)((history->duration_s / 60) % 60));
+    menu_cell_basic_draw(ctx, cell_layer, "Charts", subtitle, NULL);
+    return;
+  }
+  bool weekly = (cell_index->section == 1);
+  uint8_t len = weekly ? ROLLUP_WEEKS : ROLLUP_MONTHS;
+  uint8_t head = weekly ? s_rollups.week_head : s_rollups.month_head;
+  const RollupBucket *ring = weekly ? s_rollups.weeks : s_rollups.months;
+  const RollupBucket *bucket = &ring[(head + len - (cell_index->row % len)) % len];
+
+  char title[24];
+  char subtitle[40];
+  if (bucket->period == 0) {
+    menu_cell_basic_draw(ctx, cell_layer, "--", NULL, NULL);
+    return;
+  }
+  if (weekly) {
+    int32_t y = 0;
+    int32_t m = 1;
+    int32_t d = 1;
+    prv_civil_from_days((int32_t)bucket->period * 7 - 3, &y, &m, &d);
+    snprintf(title, sizeof(title), "Week of %ld %s", (long)d, k_months[(m - 1) % 12]);
+  } else {
+    snprintf(title, sizeof(title), "%s %ld", k_months[bucket->period % 12], (long)(2000 + bucket->period / 12));
+  }
+  bool use_imperial = (s_settings.weight_unit == 1);
+  uint32_t unit_m = use_imperial ? 1609 : 1000;
+  uint32_t dist_x10 = (bucket->distance_m * 10) / unit_m;
+  snprintf(subtitle, sizeof(subtitle), "%lu.%lu%s %ux %lu:%02luh %lukcal",
+           (unsigned long)(dist_x10 / 10), (unsigned long)(dist_x10 % 10), use_imperial ? "mi" : "km",
+           (unsigned)bucket->sessions,
+           (unsigned long)(bucket->moving_s / 3600), (unsigned long)((bucket->moving_s / 60) % 60),
+           (unsigned long)bucket->energy_kcal);
+  menu_cell_basic_draw(ctx, cell_layer, title, subtitle, NULL);
+}
+
+static void prv_stats_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *context) {
+  (void)menu_layer;
+  (void)context;
+  if (cell_index->section == 0 && cell_index->row == 0 && prv_history_get()) {
+    window_stack_push(s_history_window, true);
+  }
+}
+
+static void prv_stats_window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+  s_stats_menu_layer = menu_layer_create(bounds);
+  menu_layer_set_click_config_onto_window(s_stats_menu_layer, window);
+  menu_layer_set_normal_colors(s_stats_menu_layer, GColorBlack, GColorWhite);
+  menu_layer_set_highlight_colors(s_stats_menu_layer, GColorWhite, GColorBlack);
+  menu_layer_set_callbacks(s_stats_menu_layer, NULL, (MenuLayerCallbacks) {
+    .get_num_sections = prv_stats_get_num_sections_callback,
+    .get_num_rows = prv_stats_get_num_rows_callback,
+    .get_header_height = prv_stats_get_header_height_callback,
+    .draw_header = prv_stats_draw_header_callback,
+    .draw_row = prv_stats_draw_row_callback,
+    .select_click = prv_stats_select_callback,
+  });
+  layer_add_child(window_layer, menu_layer_get_layer(s_stats_menu_layer));
+}
+
+static void prv_stats_window_unload(Window *window) {
+  (void)window;
+  menu_layer_destroy(s_stats_menu_layer);
+  s_stats_menu_layer = NULL;
+}
+
+// Draws one chart band: a vertical min-max line per column for ranged series, a polyline for
+// cumulative ones. Values are already scaled to u8, so each column is a couple of multiplies.
+static void prv_history_draw_band(GContext *ctx, GRect band, const char *label, const HistoryRange *ranges,
+                                  const uint8_t *cumulative, uint8_t lo, uint8_t hi, bool invert) {
+  graphics_context_set_text_color(ctx, GColorWhite);
+  graphics_draw_text(ctx, label, fonts_get_system_font(FONT_KEY_GOTHIC_14),
+                     GRect(band.origin.x, band.origin.y - 2, band.size.w, 16),
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  int16_t plot_top = band.origin.y + 14;
+  int16_t plot_h = band.size.h - 16;
+  int16_t plot_bottom = plot_top + plot_h;
+  graphics_context_set_stroke_color(ctx, GColorWhite);
+  graphics_draw_line(ctx, GPoint(band.origin.x, plot_bottom), GPoint(band.origin.x + band.size.w - 1, plot_bottom));
+  if (plot_h <= 0 || hi < lo) {
+    return;
+  }
+  int32_t span = (int32_t)hi - lo;
+  if (span == 0) {
+    span = 1;
+  }
+  GPoint prev = GPoint(band.origin.x, plot_bottom);
+  for (uint16_t col = 0; col < HISTORY_COLUMNS; ++col) {
+    int16_t x = band.origin.x + (int16_t)((int32_t)col * band.size.w / HISTORY_COLUMNS);
+    if (cumulative) {
+      GPoint point = GPoint(x, plot_bottom - (int16_t)((int32_t)cumulative[col] * plot_h / UINT8_MAX));
+      graphics_draw_line(ctx, prev, point);
+      prev = point;
+      continue;
+    }
+    HistoryRange range = ranges[col];
+    if (range.min == 0 || range.min == UINT8_MAX) {
+      continue;
+    }
+    int32_t a = (range.min < lo ? lo : range.min) - lo;
+    int32_t b = (range.max > hi ? hi : range.max) - lo;
+    if (invert) {
+      // Faster (smaller) pace plots higher.
+      a = span - a;
+      b = span - b;
+    }
+    graphics_draw_line(ctx, GPoint(x, plot_bottom - (int16_t)(a * plot_h / span)),
+                       GPoint(x, plot_bottom - (int16_t)(b * plot_h / span)));
+  }
+}
+
+static void prv_history_layer_update_proc(Layer *layer, GContext *ctx) {
+  GRect bounds = layer_get_bounds(layer);
+  SessionHistory *history = prv_history_get();
+  if (!history || history->columns == 0) {
+    graphics_context_set_text_color(ctx, GColorWhite);
+    graphics_draw_text(ctx, "No saved session", fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
+                       GRect(0, bounds.size.h / 2 - 12, bounds.size.w, 24),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+    return;
+  }
+  bool use_imperial = (s_settings.weight_unit == 1);
+  int16_t margin = 4;
+  int16_t band_h = (bounds.size.h - 2 * margin) / 3;
+  int16_t band_w = bounds.size.w - 2 * margin;
+  static char pace_label[32];
+  static char hr_label[24];
+  static char energy_label[24];
+  uint32_t fast_s = (uint32_t)history->pace_lo * HISTORY_PACE_UNIT_S;
+  uint32_t slow_s = (uint32_t)history->pace_hi * HISTORY_PACE_UNIT_S;
+  if (use_imperial) {
+    fast_s = fast_s * 1609 / 1000;
+    slow_s = slow_s * 1609 / 1000;
+  }
+  snprintf(pace_label, sizeof(pace_label), "Pace %lu:%02lu-%lu:%02lu/%s",
+           (unsigned long)(fast_s / 60), (unsigned long)(fast_s % 60),
+           (unsigned long)(slow_s / 60), (unsigned long)(slow_s % 60), use_imperial ? "mi" : "km");
+  if (history->hr_hi > 0) {
+    snprintf(hr_label, sizeof(hr_label), "HR %u-%u bpm", (unsigned)history->hr_lo, (unsigned)history->hr_hi);
+  } else {
+    snprintf(hr_label, sizeof(hr_label), "HR --");
+  }
+  snprintf(energy_label, sizeof(energy_label), "Energy %ld kcal", (long)history->energy_total_kcal);
+
+  prv_history_draw_band(ctx, GRect(margin, margin, band_w, band_h), pace_label, history->pace, NULL,
+                        history->pace_lo, history->pace_hi, true);
+  prv_history_draw_band(ctx, GRect(margin, margin + band_h, band_w, band_h), hr_label, history->hr, NULL,
+                        history->hr_lo, history->hr_hi, false);
+  prv_history_draw_band(ctx, GRect(margin, margin + 2 * band_h, band_w, band_h), energy_label, NULL,
+                        history->energy, 0, UINT8_MAX, false);
+}
+
+static void prv_history_window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+  s_history_layer = layer_create(bounds);
+  layer_set_update_proc(s_history_layer, prv_history_layer_update_proc);
+  layer_add_child(window_layer, s_history_layer);
+}
+
+static void prv_history_window_unload(Window *window) {
+  (void)window;
+  layer_destroy(s_history_layer);
+  s_history_layer = NULL;
+}
+
 static void prv_status_timer_callback(void *context) {
   (void)context;
   s_status_timer = NULL;
@@ -1017,10 +4929,36 @@ static void prv_main_up_click_handler(ClickRecognizerRef recognizer, void *conte
   window_stack_push(s_music_window, true);
 }
 
+static void prv_main_up_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  (void)recognizer;
+  (void)context;
+  window_stack_push(s_stats_window, true);
+}
+
+static void prv_main_select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  (void)recognizer;
+  (void)context;
+  prv_display_wake();
+  if (s_paused) {
+    prv_session_resume();
+  } else {
+    prv_session_pause(true);
+  }
+  vibes_short_pulse();
+  prv_update_display();
+}
+
+static void prv_window_appear(Window *window) {
+  (void)window;
+  prv_display_wake();
+}
+
 static void prv_main_click_config_provider(void *context) {
   (void)context;
   window_single_click_subscribe(BUTTON_ID_BACK, prv_main_back_click_handler);
   window_single_click_subscribe(BUTTON_ID_UP, prv_main_up_click_handler);
+  window_long_click_subscribe(BUTTON_ID_UP, 500, prv_main_up_long_click_handler, NULL);
+  window_single_click_subscribe(BUTTON_ID_SELECT, prv_main_select_click_handler);
   window_single_click_subscribe(BUTTON_ID_DOWN, prv_main_down_click_handler);
 }
 
@@ -1044,9 +4982,10 @@ static void prv_profile_window_load(Window *window) {
   menu_layer_pad_bottom_enable(s_profile_menu_layer, false);
   menu_layer_set_normal_colors(s_profile_menu_layer, GColorBlack, GColorWhite);
   menu_layer_set_highlight_colors(s_profile_menu_layer, GColorBlack, GColorWhite);
-  s_profile_weight_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_WEIGHT);
-  s_profile_terrain_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_TERRAIN);
-  s_profile_grade_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_GRADE);
+  s_profile_weight_icon = prv_icon_acquire(RESOURCE_ID_ICON_WEIGHT);
+  s_profile_terrain_icon = prv_icon_acquire(RESOURCE_ID_ICON_TERRAIN);
+  s_profile_grade_icon = prv_icon_acquire(RESOURCE_ID_ICON_GRADE);
+  s_profile_row_layout.valid = false;
   menu_layer_set_selected_index(s_profile_menu_layer, (MenuIndex) { .section = 0, .row = prv_active_profile_index() },
                                 MenuRowAlignNone, false);
   prv_profile_reset_scroll_offset();
@@ -1057,9 +4996,9 @@ static void prv_profile_window_unload(Window *window) {
   (void)window;
   menu_layer_destroy(s_profile_menu_layer);
   s_profile_menu_layer = NULL;
-  gbitmap_destroy(s_profile_weight_icon);
-  gbitmap_destroy(s_profile_terrain_icon);
-  gbitmap_destroy(s_profile_grade_icon);
+  prv_icon_release(s_profile_weight_icon);
+  prv_icon_release(s_profile_terrain_icon);
+  prv_icon_release(s_profile_grade_icon);
   s_profile_weight_icon = NULL;
   s_profile_terrain_icon = NULL;
   s_profile_grade_icon = NULL;
@@ -1100,11 +5039,11 @@ static void prv_window_load(Window *window) {
   s_bottom_right_value_layer = text_layer_create(GRect(x0 + (w / 2), y0 + 162, w - (w / 2), 28));
   s_bottom_right_secondary_layer = text_layer_create(GRect(x0 + (w / 2), y0 + 188, w - (w / 2), 28));
 
-  s_runner_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_RUNNER);
-  s_heart_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_HEART);
-  s_timer_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_TIMER);
-  s_steps_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_STEPS);
-  s_fire_icon = gbitmap_create_with_resource(RESOURCE_ID_ICON_FIRE);
+  s_runner_icon = prv_icon_acquire(RESOURCE_ID_ICON_RUNNER);
+  s_heart_icon = prv_icon_acquire(RESOURCE_ID_ICON_HEART);
+  s_timer_icon = prv_icon_acquire(RESOURCE_ID_ICON_TIMER);
+  s_steps_icon = prv_icon_acquire(RESOURCE_ID_ICON_STEPS);
+  s_fire_icon = prv_icon_acquire(RESOURCE_ID_ICON_FIRE);
   bitmap_layer_set_bitmap(s_mid_left_icon_layer, s_runner_icon);
   bitmap_layer_set_bitmap(s_mid_center_icon_layer, s_heart_icon);
   bitmap_layer_set_bitmap(s_mid_right_icon_layer, s_timer_icon);
@@ -1170,15 +5109,23 @@ static void prv_window_unload(Window *window) {
   bitmap_layer_destroy(s_bottom_right_icon_layer);
   text_layer_destroy(s_bottom_right_value_layer);
   text_layer_destroy(s_bottom_right_secondary_layer);
-  gbitmap_destroy(s_runner_icon);
-  gbitmap_destroy(s_heart_icon);
-  gbitmap_destroy(s_timer_icon);
-  gbitmap_destroy(s_steps_icon);
-  gbitmap_destroy(s_fire_icon);
+  prv_icon_release(s_runner_icon);
+  prv_icon_release(s_heart_icon);
+  prv_icon_release(s_timer_icon);
+  prv_icon_release(s_steps_icon);
+  prv_icon_release(s_fire_icon);
+  s_runner_icon = NULL;
+  s_heart_icon = NULL;
+  s_timer_icon = NULL;
+  s_steps_icon = NULL;
+  s_fire_icon = NULL;
 }
 
 static void prv_init(void) {
   prv_load_settings();
+  prv_energy_model_refresh();
+  prv_recalc_baseline_capture();
+  prv_profile_rows_rebuild();
   if (persist_exists(LIFETIME_DISTANCE_M_PERSIST_KEY)) {
     s_lifetime_distance_m = persist_read_int(LIFETIME_DISTANCE_M_PERSIST_KEY);
   }
@@ -1197,10 +5144,16 @@ static void prv_init(void) {
   if (persist_exists(LAST_ACTIVITY_TIMESTAMP_PERSIST_KEY)) {
     s_last_activity_timestamp = persist_read_int(LAST_ACTIVITY_TIMESTAMP_PERSIST_KEY);
   }
+  prv_rollups_load();
+  prv_histograms_load();
+  prv_stride_tables_load();
+  prv_recalc_recover();
+  prv_workout_load();
 
   s_window = window_create();
   window_set_window_handlers(s_window, (WindowHandlers) {
     .load = prv_window_load,
+    .appear = prv_window_appear,
     .unload = prv_window_unload,
   });
 
@@ -1217,6 +5170,20 @@ static void prv_init(void) {
     .unload = prv_music_window_unload,
   });
 
+  s_stats_window = window_create();
+  window_set_background_color(s_stats_window, GColorBlack);
+  window_set_window_handlers(s_stats_window, (WindowHandlers) {
+    .load = prv_stats_window_load,
+    .unload = prv_stats_window_unload,
+  });
+
+  s_history_window = window_create();
+  window_set_background_color(s_history_window, GColorBlack);
+  window_set_window_handlers(s_history_window, (WindowHandlers) {
+    .load = prv_history_window_load,
+    .unload = prv_history_window_unload,
+  });
+
   s_status_window = window_create();
   window_set_background_color(s_status_window, GColorBlack);
   window_set_window_handlers(s_status_window, (WindowHandlers) {
@@ -1224,7 +5191,11 @@ static void prv_init(void) {
     .unload = prv_status_window_unload,
   });
 
-  time_t now = time(NULL);
+  // The implicit session that runs until a profile is picked counts active time from launch,
+  // like an explicit one; a checkpoint restore below replaces it.
+  prv_clock_sync_scale();
+  prv_clock_start(0, false);
+  time_t now = prv_session_now();
   s_start_time = now;
   struct tm *start_tm = localtime(&now);
   if (start_tm) {
@@ -1240,22 +5211,46 @@ static void prv_init(void) {
   if (s_health_available) {
     health_service_events_subscribe(prv_health_handler, NULL);
   }
+  prv_sampler_reset(0);
+  prv_histograms_reset((int32_t)now, 0);
+  bool restored = prv_checkpoint_restore(now);
+  prv_accel_apply_policy();
 
-  tick_timer_service_subscribe(SECOND_UNIT, prv_tick_handler);
+  prv_power_init();
+  prv_tick_policy_apply();
+  prv_display_apply_policy();
 
   app_message_register_inbox_received(prv_inbox_received_handler);
   app_message_register_inbox_dropped(prv_inbox_dropped_handler);
-  app_message_register_outbox_failed(prv_outbox_failed_handler);
+  prv_outbox_init();
   app_message_open(1024, 128);
   APP_LOG(APP_LOG_LEVEL_INFO, "App initialized, waiting for config updates");
 
   window_stack_push(s_window, false);
-  window_stack_push(s_profile_window, true);
+  if (!restored) {
+    window_stack_push(s_profile_window, true);
+  }
 }
 
 static void prv_deinit(void) {
+  prv_recalc_stop();
+  prv_pacer_stop();
   prv_commit_session_totals("deinit");
+  prv_replay_stop();
+  free(s_replay.uploaded);
+  s_replay.uploaded = NULL;
   tick_timer_service_unsubscribe();
+  prv_power_deinit();
+  prv_outbox_deinit();
+  if (s_accel.subscribed) {
+    accel_data_service_unsubscribe();
+  }
+  if (s_display.subscribed) {
+    accel_tap_service_unsubscribe();
+  }
+  if (s_display.wake_timer) {
+    app_timer_cancel(s_display.wake_timer);
+  }
   if (s_health_available) {
     health_service_events_unsubscribe();
   }
@@ -1265,8 +5260,13 @@ static void prv_deinit(void) {
   }
   window_destroy(s_status_window);
   window_destroy(s_music_window);
+  window_destroy(s_history_window);
+  window_destroy(s_stats_window);
   window_destroy(s_profile_window);
   window_destroy(s_window);
+  prv_icon_cache_destroy();
+  free(s_history);
+  s_history = NULL;
 }
 
 int main(void) {
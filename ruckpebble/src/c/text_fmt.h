@@ -0,0 +1,94 @@
+// Small append-only formatters for the per-tick dashboard and profile rows, so the hot path does
+// not go through newlib's snprintf. Output is always NUL-terminated and truncates like snprintf.
+// Kept free of Pebble APIs so scripts/fmt-test.c can check them against snprintf on the host.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  char *buf;
+  size_t size;
+  size_t len;
+} TextBuf;
+
+static inline TextBuf prv_fmt_begin(char *buf, size_t size) {
+  TextBuf text = { .buf = buf, .size = size, .len = 0 };
+  if (size > 0) {
+    buf[0] = '\0';
+  }
+  return text;
+}
+
+static inline void prv_fmt_char(TextBuf *text, char c) {
+  if (text->len + 1 < text->size) {
+    text->buf[text->len++] = c;
+    text->buf[text->len] = '\0';
+  }
+}
+
+static inline void prv_fmt_str(TextBuf *text, const char *str) {
+  while (str && *str) {
+    prv_fmt_char(text, *str++);
+  }
+}
+
+// Decimal with at least min_digits digits, zero padded.
+static inline void prv_fmt_uint(TextBuf *text, uint32_t value, uint8_t min_digits) {
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (count < min_digits && count < sizeof(digits)) {
+    digits[count++] = '0';
+  }
+  while (count > 0) {
+    prv_fmt_char(text, digits[--count]);
+  }
+}
+
+static inline void prv_fmt_int(TextBuf *text, int32_t value) {
+  uint32_t magnitude = (uint32_t)value;
+  if (value < 0) {
+    prv_fmt_char(text, '-');
+    magnitude = 0u - magnitude;
+  }
+  prv_fmt_uint(text, magnitude, 1);
+}
+
+// Fixed-point value with the given number of decimals, e.g. (1234, 2) -> "12.34", then suffix.
+static inline void prv_fmt_fixed(TextBuf *text, int32_t value, uint8_t decimals, const char *suffix) {
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < decimals; ++i) {
+    scale *= 10;
+  }
+  uint32_t magnitude = (uint32_t)value;
+  if (value < 0) {
+    prv_fmt_char(text, '-');
+    magnitude = 0u - magnitude;
+  }
+  prv_fmt_uint(text, magnitude / scale, 1);
+  if (decimals > 0) {
+    prv_fmt_char(text, '.');
+    prv_fmt_uint(text, magnitude % scale, decimals);
+  }
+  prv_fmt_str(text, suffix);
+}
+
+// "m:ss"; minutes are not wrapped into hours.
+static inline void prv_fmt_mmss(TextBuf *text, uint32_t seconds) {
+  prv_fmt_uint(text, seconds / 60, 1);
+  prv_fmt_char(text, ':');
+  prv_fmt_uint(text, seconds % 60, 2);
+}
+
+// "h:mm:ss".
+static inline void prv_fmt_hmmss(TextBuf *text, uint32_t seconds) {
+  prv_fmt_uint(text, seconds / 3600, 1);
+  prv_fmt_char(text, ':');
+  prv_fmt_uint(text, (seconds / 60) % 60, 2);
+  prv_fmt_char(text, ':');
+  prv_fmt_uint(text, seconds % 60, 2);
+}
@@ -0,0 +1,382 @@
+/* Session history: a columnar binary log of committed sessions, kept on the phone. */
+var STORAGE_KEY = 'ruck_history_v1';
+var VERSION = 1;
+var HEADER_BYTES = 8;
+var ROW_BYTES = 12;
+var MAX_SESSIONS = 4000;            // ten years of daily rucks in 48 KB
+// Column order is the on-disk order; the 4-byte columns come first so every column stays aligned.
+var COLUMNS = [
+  { name: 'start_time', bytes: 4 },
+  { name: 'distance_m', bytes: 4 },
+  { name: 'kcal', bytes: 2 },
+  { name: 'pace_s', bytes: 2 }
+];
+var BASE64 = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/';
+
+// The PebbleKit JS runtime has no btoa/atob on every platform.
+function toBase64(bytes) {
+  var out = '';
+  for (var i = 0; i < bytes.length; i += 3) {
+    var chunk = (bytes[i] << 16) | ((bytes[i + 1] || 0) << 8) | (bytes[i + 2] || 0);
+    out += BASE64.charAt(chunk >> 18) + BASE64.charAt((chunk >> 12) & 63) +
+      (i + 1 < bytes.length ? BASE64.charAt((chunk >> 6) & 63) : '=') +
+      (i + 2 < bytes.length ? BASE64.charAt(chunk & 63) : '=');
+  }
+  return out;
+}
+
+function fromBase64(text) {
+  var bytes = [];
+  var clean = String(text || '').replace(/[^A-Za-z0-9+/]/g, '');
+  for (var i = 0; i + 1 < clean.length; i += 4) {
+    var chunk = 0;
+    for (var k = 0; k < 4; ++k) {
+      chunk = (chunk << 6) | (i + k < clean.length ? BASE64.indexOf(clean.charAt(i + k)) : 0);
+    }
+    bytes.push((chunk >> 16) & 0xFF);
+    if (i + 2 < clean.length) {
+      bytes.push((chunk >> 8) & 0xFF);
+    }
+    if (i + 3 < clean.length) {
+      bytes.push(chunk & 0xFF);
+    }
+  }
+  return bytes;
+}
+
+// 'R', 'H', version, reserved byte, session count as uint32, then each column in turn as
+// little-endian values.
+function encode(columns) {
+  var count = columns.start_time.length;
+  var bytes = [0x52, 0x48, VERSION, 0, count & 0xFF, (count >> 8) & 0xFF, (count >> 16) & 0xFF, (count >>> 24) & 0xFF];
+  COLUMNS.forEach(function(column) {
+    columns[column.name].forEach(function(value) {
+      for (var b = 0; b < column.bytes; ++b) {
+        bytes.push((value >>> (8 * b)) & 0xFF);
+      }
+    });
+  });
+  return bytes;
+}
+
+function decode(bytes) {
+  var columns = {};
+  COLUMNS.forEach(function(column) {
+    columns[column.name] = [];
+  });
+  if (!bytes || bytes.length < HEADER_BYTES || bytes[0] !== 0x52 || bytes[1] !== 0x48 || bytes[2] !== VERSION) {
+    return columns;
+  }
+  var count = (bytes[4] | (bytes[5] << 8) | (bytes[6] << 16) | (bytes[7] << 24)) >>> 0;
+  var offset = HEADER_BYTES;
+  if (offset + count * ROW_BYTES > bytes.length) {
+    return columns;
+  }
+  COLUMNS.forEach(function(column) {
+    for (var i = 0; i < count; ++i, offset += column.bytes) {
+      var value = 0;
+      for (var b = column.bytes - 1; b >= 0; --b) {
+        value = value * 256 + bytes[offset + b];
+      }
+      columns[column.name].push(value);
+    }
+  });
+  return columns;
+}
+
+function load() {
+  return decode(fromBase64(localStorage.getItem(STORAGE_KEY)));
+}
+
+// SessionRecord as sent by the watch at commit: version, three reserved bytes, then start time,
+// distance in m, kcal, pace in s per km and elapsed s as little-endian int32.
+function decodeRecord(bytes) {
+  function i32(offset) {
+    return bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (bytes[offset + 3] << 24);
+  }
+  if (!bytes || bytes.length < 24 || bytes[0] !== 1) {
+    return null;
+  }
+  return {
+    start_time: i32(4),
+    distance_m: i32(8),
+    kcal: i32(12),
+    pace_s: i32(16),
+    elapsed_s: i32(20)
+  };
+}
+
+// Appends a committed session. The watch sends a session again after a recalculation, so a
+// repeat of the newest session is only written when it changed.
+function record(session) {
+  if (!(session.start_time > 0) || !(session.distance_m > 0)) {
+    return false;
+  }
+  var columns = load();
+  var last = columns.start_time.length - 1;
+  var row = {
+    start_time: session.start_time,
+    distance_m: Math.min(0xFFFFFFFF, session.distance_m),
+    kcal: Math.max(0, Math.min(0xFFFF, session.kcal | 0)),
+    pace_s: Math.max(0, Math.min(0xFFFF, session.pace_s | 0))
+  };
+  if (last >= 0 && row.start_time < columns.start_time[last]) {
+    return false;
+  }
+  if (last >= 0 && row.start_time === columns.start_time[last]) {
+    var same = COLUMNS.every(function(column) {
+      return columns[column.name][last] === row[column.name];
+    });
+    if (same) {
+      return false;
+    }
+    COLUMNS.forEach(function(column) {
+      columns[column.name].pop();
+    });
+  }
+  COLUMNS.forEach(function(column) {
+    columns[column.name].push(row[column.name]);
+    columns[column.name] = columns[column.name].slice(-MAX_SESSIONS);
+  });
+  localStorage.setItem(STORAGE_KEY, toBase64(encode(columns)));
+  return true;
+}
+
+// The stored blob as is, for the config page to decode itself.
+function blob() {
+  return localStorage.getItem(STORAGE_KEY) || '';
+}
+
+// Self-contained so the config page can embed it with Function.prototype.toString(). Decodes the
+// blob into typed columns, fills a virtualized session list that only keeps enough rows for the
+// viewport, and draws the charts on canvas after the first paint. Chart work is bounded by the
+// canvas width: weeks are merged until every bar gets a few pixels, and pace is reduced to one
+// mean and range per pixel column.
+function showHistory(blobText, imperial) {
+  var ROW_HEIGHT = 32;
+  var OVERSCAN = 4;
+  var MIN_BAR_PX = 3;
+  var WEEK_S = 604800;
+  var MONDAY_EPOCH_S = 345600;      // 1970-01-05 was a Monday
+  var unitM = imperial ? 1609.344 : 1000;
+  var unitLabel = imperial ? 'mi' : 'km';
+  function byId(id) {
+    return document.getElementById(id);
+  }
+  var raw = blobText ? atob(blobText) : '';
+  var bytes = new Uint8Array(raw.length);
+  for (var b = 0; b < raw.length; ++b) {
+    bytes[b] = raw.charCodeAt(b);
+  }
+  var view = new DataView(bytes.buffer);
+  var n = 0;
+  if (bytes.length >= 8 && bytes[0] === 0x52 && bytes[1] === 0x48 && bytes[2] === 1) {
+    n = view.getUint32(4, true);
+  }
+  if (8 + n * 12 > bytes.length) {
+    n = 0;
+  }
+  var time = new Uint32Array(n);
+  var dist = new Uint32Array(n);
+  var kcal = new Uint16Array(n);
+  var pace = new Uint16Array(n);
+  var offset = 8;
+  var i;
+  for (i = 0; i < n; ++i, offset += 4) {
+    time[i] = view.getUint32(offset, true);
+  }
+  for (i = 0; i < n; ++i, offset += 4) {
+    dist[i] = view.getUint32(offset, true);
+  }
+  for (i = 0; i < n; ++i, offset += 2) {
+    kcal[i] = view.getUint16(offset, true);
+  }
+  for (i = 0; i < n; ++i, offset += 2) {
+    pace[i] = view.getUint16(offset, true);
+  }
+  if (n === 0) {
+    byId('history_summary').textContent = 'No sessions recorded on this phone yet.';
+    byId('history_volume').style.display = 'none';
+    byId('history_pace').style.display = 'none';
+    byId('history_list').style.display = 'none';
+    return;
+  }
+
+  function paceText(secPerKm) {
+    if (!secPerKm) {
+      return '--';
+    }
+    var s = Math.round(imperial ? secPerKm * 1.609344 : secPerKm);
+    return Math.floor(s / 60) + ':' + ('0' + (s % 60)).slice(-2);
+  }
+  var total = 0;
+  for (i = 0; i < n; ++i) {
+    total += dist[i];
+  }
+  byId('history_summary').textContent = n + ' sessions, ' + (total / unitM).toFixed(1) + ' ' + unitLabel +
+    ' since ' + new Date(time[0] * 1000).toLocaleDateString();
+
+  // Newest first. Rows are recycled by index modulo the pool size, so a scroll frame only
+  // rewrites the rows that came into view.
+  var list = byId('history_list');
+  var spacer = document.createElement('div');
+  spacer.style.position = 'relative';
+  spacer.style.height = (n * ROW_HEIGHT) + 'px';
+  list.appendChild(spacer);
+  var pool = [];
+  var poolSize = Math.min(n, Math.ceil((list.clientHeight || 240) / ROW_HEIGHT) + 2 * OVERSCAN);
+  for (i = 0; i < poolSize; ++i) {
+    var el = document.createElement('div');
+    el.className = 'vrow';
+    spacer.appendChild(el);
+    pool.push({ el: el, index: -1 });
+  }
+  function rowText(index) {
+    var j = n - 1 - index;
+    return new Date(time[j] * 1000).toLocaleDateString() + '  ' + (dist[j] / unitM).toFixed(2) + ' ' + unitLabel +
+      '  ' + paceText(pace[j]) + '/' + unitLabel + '  ' + kcal[j] + ' kcal';
+  }
+  var scheduled = false;
+  function renderRows() {
+    scheduled = false;
+    var first = Math.max(0, Math.floor(list.scrollTop / ROW_HEIGHT) - OVERSCAN);
+    var end = Math.min(n, first + poolSize);
+    for (var index = first; index < end; ++index) {
+      var row = pool[index % poolSize];
+      if (row.index !== index) {
+        row.index = index;
+        row.el.style.top = (index * ROW_HEIGHT) + 'px';
+        row.el.textContent = rowText(index);
+      }
+    }
+  }
+  var nextFrame = window.requestAnimationFrame || function(fn) { return setTimeout(fn, 16); };
+  list.addEventListener('scroll', function() {
+    if (!scheduled) {
+      scheduled = true;
+      nextFrame(renderRows);
+    }
+  });
+  renderRows();
+
+  function surface(id) {
+    var canvas = byId(id);
+    var ratio = window.devicePixelRatio || 1;
+    var w = canvas.clientWidth || 300;
+    var h = canvas.clientHeight || 120;
+    canvas.width = Math.round(w * ratio);
+    canvas.height = Math.round(h * ratio);
+    var ctx = canvas.getContext('2d');
+    ctx.scale(ratio, ratio);
+    ctx.font = '11px Helvetica,Arial,sans-serif';
+    return { ctx: ctx, w: w, h: h };
+  }
+
+  function drawVolume() {
+    var tz = new Date().getTimezoneOffset() * 60;
+    function week(t) {
+      return Math.floor((t - tz - MONDAY_EPOCH_S) / WEEK_S);
+    }
+    var firstWeek = week(time[0]);
+    var weeks = week(time[n - 1]) - firstWeek + 1;
+    var c = surface('history_volume');
+    var group = Math.max(1, Math.ceil(weeks * MIN_BAR_PX / c.w));
+    var bars = new Float64Array(Math.ceil(weeks / group));
+    for (var k = 0; k < n; ++k) {
+      bars[Math.floor((week(time[k]) - firstWeek) / group)] += dist[k];
+    }
+    var max = 0;
+    for (k = 0; k < bars.length; ++k) {
+      max = Math.max(max, bars[k]);
+    }
+    var top = 14;
+    var barW = c.w / bars.length;
+    c.ctx.fillStyle = '#111';
+    for (k = 0; k < bars.length; ++k) {
+      var bh = max > 0 ? bars[k] / max * (c.h - top) : 0;
+      c.ctx.fillRect(k * barW, c.h - bh, Math.max(1, barW - 1), bh);
+    }
+    c.ctx.fillStyle = '#666';
+    c.ctx.fillText('max ' + (max / unitM).toFixed(1) + ' ' + unitLabel + (group > 1 ? ' per ' + group + ' weeks' : ' per week'),
+                   0, 10);
+  }
+
+  function drawPace() {
+    var c = surface('history_pace');
+    var cols = Math.max(1, Math.floor(c.w));
+    var sum = new Float64Array(cols);
+    var count = new Uint32Array(cols);
+    var lo = new Float64Array(cols);
+    var hi = new Float64Array(cols);
+    var span = Math.max(1, time[n - 1] - time[0]);
+    var fastest = Infinity;
+    var slowest = 0;
+    for (var k = 0; k < n; ++k) {
+      if (!pace[k]) {
+        continue;
+      }
+      var x = Math.min(cols - 1, Math.floor((time[k] - time[0]) / span * (cols - 1)));
+      lo[x] = count[x] ? Math.min(lo[x], pace[k]) : pace[k];
+      hi[x] = Math.max(hi[x], pace[k]);
+      sum[x] += pace[k];
+      count[x]++;
+      fastest = Math.min(fastest, pace[k]);
+      slowest = Math.max(slowest, pace[k]);
+    }
+    if (!slowest) {
+      return;
+    }
+    var top = 14;
+    var range = Math.max(1, slowest - fastest);
+    // Faster is up.
+    function y(p) {
+      return top + (p - fastest) / range * (c.h - top - 2);
+    }
+    c.ctx.strokeStyle = '#bbb';
+    c.ctx.beginPath();
+    for (k = 0; k < cols; ++k) {
+      if (count[k] > 1) {
+        c.ctx.moveTo(k + 0.5, y(lo[k]));
+        c.ctx.lineTo(k + 0.5, y(hi[k]));
+      }
+    }
+    c.ctx.stroke();
+    c.ctx.strokeStyle = '#111';
+    c.ctx.lineWidth = 1.5;
+    c.ctx.beginPath();
+    var started = false;
+    for (k = 0; k < cols; ++k) {
+      if (count[k]) {
+        var py = y(sum[k] / count[k]);
+        if (started) {
+          c.ctx.lineTo(k + 0.5, py);
+        } else {
+          c.ctx.moveTo(k + 0.5, py);
+          started = true;
+        }
+      }
+    }
+    c.ctx.stroke();
+    c.ctx.fillStyle = '#666';
+    c.ctx.fillText('fastest ' + paceText(fastest) + ', slowest ' + paceText(slowest) + ' /' + unitLabel, 0, 10);
+  }
+
+  // Let the form paint before any chart work.
+  setTimeout(function() {
+    drawVolume();
+    drawPace();
+  }, 0);
+}
+
+module.exports = {
+  STORAGE_KEY: STORAGE_KEY,
+  MAX_SESSIONS: MAX_SESSIONS,
+  encode: encode,
+  decode: decode,
+  toBase64: toBase64,
+  fromBase64: fromBase64,
+  decodeRecord: decodeRecord,
+  record: record,
+  blob: blob,
+  showHistory: showHistory
+};
@@ -1,5 +1,10 @@
 /* Settings page for Pebble app with shared settings + 3 profiles. */
 (function() {
+  var replay = require('./replay');
+  var workout = require('./workout');
+  var route = require('./route');
+  var stride = require('./stride');
+  var history = require('./history');
   var SETTINGS_KEY = 'ruck_settings_v2';
 
   var defaults = {
@@ -8,22 +13,44 @@
     ruck_weight_unit: 1,
     stride_length_value: 780,
     stride_length_unit: 0,
+    age_years: 35,
+    sex: 0,
+    auto_pause_seconds: 60,
+    planned_duration_min: 0,
+    step_source: 0,
+    accel_threshold_mg: 90,
+    accel_min_step_ms: 280,
+    display_wake_s: 0,
+    ghost_mode: 0,
+    workout_text: '',
 
     profile1_ruck_weight_value: 300,
     profile1_terrain_factor: 100,
     profile1_terrain_type: 'road',
+    profile1_energy_model: 0,
+    profile1_pacer_spm: 0,
+    profile1_pacer_pace_s: 0,
+    profile1_route_summary: '',
     profile1_grade_percent: 0,
     profile1_name: '30lb, road',
 
     profile2_ruck_weight_value: 150,
     profile2_terrain_factor: 100,
     profile2_terrain_type: 'gravel',
+    profile2_energy_model: 0,
+    profile2_pacer_spm: 0,
+    profile2_pacer_pace_s: 0,
+    profile2_route_summary: '',
     profile2_grade_percent: 100,
     profile2_name: '15lb, trail, hilly',
 
     profile3_ruck_weight_value: 300,
     profile3_terrain_factor: 130,
     profile3_terrain_type: 'mixed',
+    profile3_energy_model: 0,
+    profile3_pacer_spm: 0,
+    profile3_pacer_pace_s: 0,
+    profile3_route_summary: '',
     profile3_grade_percent: 0,
     profile3_name: '',
     lifetime_distance_m_total: 0,
@@ -32,10 +59,15 @@
     last_activity_calories: 0,
     last_activity_pace_sec: 0,
     last_activity_timestamp: 0,
+    last_activity_histograms: null,
+    stride_calibrations: [],
 
     sim_steps_enabled: 1,
     sim_steps_spm: 122
   };
+  // Kept on the phone only; never part of the settings message to the watch.
+  var PHONE_ONLY_KEYS = ['workout_text', 'profile1_route_summary', 'profile2_route_summary', 'profile3_route_summary',
+    'last_activity_histograms', 'stride_calibrations'];
   var s_waitingLifetimeCallback = null;
 
   function loadSettings() {
@@ -71,13 +103,65 @@
     return out;
   }
 
-  function syncSettingsToWatch(settings) {
+  // The workout travels as its compiled step program; the source text stays on the phone. The
+  // page rejects text that does not compile, so a failure here leaves the watch's program alone.
+  function compileWorkout(settings) {
+    try {
+      return workout.compile(settings.workout_text, settings.weight_unit === 1).bytes;
+    } catch (e) {
+      console.log('workout compile failed, keeping the previous program:', e.message);
+      return null;
+    }
+  }
+
+  // onDone gets whether the watch acknowledged the settings; it runs either way, so the messages
+  // queued behind the settings are not lost with them.
+  function syncSettingsToWatch(settings, onDone) {
     var normalized = normalizeSettings(settings);
     saveSettings(normalized);
-    Pebble.sendAppMessage(normalized, function() {
+    var message = Object.assign({}, normalized);
+    PHONE_ONLY_KEYS.forEach(function(key) {
+      delete message[key];
+    });
+    var program = compileWorkout(normalized);
+    if (program) {
+      message.workout_program = program;
+    }
+    Pebble.sendAppMessage(message, function() {
       console.log('initial/send settings success');
+      if (onDone) {
+        onDone(true);
+      }
     }, function(err) {
       console.log('initial/send settings failed:', JSON.stringify(err));
+      if (onDone) {
+        onDone(false);
+      }
+    });
+  }
+
+  // Replay requests ride along with the config page result but are never persisted as settings.
+  function startReplay(trace, speed) {
+    if (trace === 'builtin') {
+      replay.startBuiltin(speed);
+    } else if (trace === 'synthetic') {
+      replay.uploadAndStart(replay.generateLongRuck({ hours: 10, seed: Date.now() & 0xFFFF }), speed);
+    } else if (trace === 'stop_and_go') {
+      replay.uploadAndStart(replay.fromCompact(require('./traces/stop_and_go.json')), speed);
+    }
+  }
+
+  // Recalculation runs on the watch after the corrected settings have landed.
+  function requestRecalculation(target, onDone) {
+    Pebble.sendAppMessage({ recalculate: target }, function() {
+      if (onDone) {
+        onDone();
+      }
+    }, function(e) {
+      console.log('recalculate send failed:', JSON.stringify(e));
+      if (onDone) {
+        onDone();
+      }
     });
   }
 
@@ -117,6 +201,89 @@
       '<option value="snow">Snow (1.5)</option>';
   }
 
+  function energyModelOptionsHtml() {
+    return '' +
+      '<option value="0">Pandolf + Santee downhill</option>' +
+      '<option value="1">LCDA (Looney)</option>' +
+      '<option value="2">Heart rate (Keytel)</option>';
+  }
+
+  function routeFieldsHtml(n) {
+    return '<label>Route (GPX, replaces fixed grade)</label>' +
+      '<input type="file" id="p' + n + '_route_file" accept=".gpx,application/gpx+xml">' +
+      '<div class="row"><div><input type="text" id="p' + n + '_route_summary" readonly placeholder="No route"></div>' +
+      '<div><button type="button" id="p' + n + '_route_clear">Clear</button></div></div>';
+  }
+
+  // Route tables go one profile per message, after the settings sync. A profile's route summary
+  // is only stored once the watch has its table, so the page never shows a route the watch lacks.
+  function sendRouteUpdates(updates, onDone) {
+    if (!updates.length) {
+      if (onDone) {
+        onDone();
+      }
+      return;
+    }
+    var update = updates[0];
+    route.sendToWatch(update.profile, update.segments, function(ok) {
+      if (ok) {
+        var stored = loadSettings();
+        stored['profile' + (update.profile + 1) + '_route_summary'] = update.summary || '';
+        saveSettings(stored);
+      }
+      sendRouteUpdates(updates.slice(1), onDone);
+    });
+  }
+
+  // A measured distance for the newest calibration record refits that record's profile; a reset
+  // drops a profile's records and its table. The stored records only change once the watch has
+  // acknowledged the table, so a failed send is retried by the next save.
+  function strideUpdates(settings, measuredM, resetProfile) {
+    var records = settings.stride_calibrations || [];
+    var updates = [];
+    if (resetProfile > 0) {
+      records = records.filter(function(r) { return r.profile !== resetProfile - 1; });
+      updates.push({ profile: resetProfile - 1, knots: null });
+    }
+    if (measuredM > 0 && records.length && measuredM !== records[0].measured_m) {
+      var measured = records.map(function(r, i) {
+        return i === 0 ? Object.assign({}, r, { measured_m: measuredM }) : r;
+      });
+      var knots = stride.fit(measured, records[0].profile, stride.strideFromSettings(settings));
+      if (knots) {
+        updates.push({ profile: records[0].profile, knots: knots, start_time: records[0].start_time, measured_m: measuredM });
+      }
+    }
+    return updates;
+  }
+
+  function applyStrideUpdate(records, update) {
+    if (!update.knots) {
+      return records.filter(function(r) { return r.profile !== update.profile; });
+    }
+    return records.map(function(r) {
+      return r.start_time === update.start_time ? Object.assign({}, r, { measured_m: update.measured_m }) : r;
+    });
+  }
+
+  function sendStrideUpdates(updates, onDone) {
+    if (!updates.length) {
+      if (onDone) {
+        onDone();
+      }
+      return;
+    }
+    var update = updates[0];
+    stride.sendToWatch(update.profile, update.knots, function(ok) {
+      if (ok) {
+        var stored = loadSettings();
+        stored.stride_calibrations = applyStrideUpdate(stored.stride_calibrations || [], update);
+        saveSettings(stored);
+      }
+      sendStrideUpdates(updates.slice(1), onDone);
+    });
+  }
+
   function requestLifetimeTotals(onComplete) {
     var done = false;
     function finish() {
@@ -144,6 +311,7 @@
     var p2TerrainType = terrainTypeFromSettings(s.profile2_terrain_type, s.profile2_terrain_factor);
     var p3TerrainType = terrainTypeFromSettings(s.profile3_terrain_type, s.profile3_terrain_factor);
     var terrainOptions = terrainOptionsHtml();
+    var energyModelOptions = energyModelOptionsHtml();
     var weightIcon = 'data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAABgAAAAYCAYAAADgdz34AAABYUlEQVR4AeRU4VUDMQgmncARdAPdQCdwBN3AbtJVdAPdoBvoBk6g9IOQ3LWBK32v/dW8EDj44MuRvKzowuOKCJh5w9PYZDubatEfihPTmqaxBleKJEUAkBYvNoxHfWaHCrlh7CyBkAAt+OV/rJjKVIjYHGiXulhGxXyrw1lcAuS9AnsDOZhgEY8p7jbfIsdtmUuAvDdLfrK2u2oFL7APRMr4Qs6ICO4Fi/xP0UsCzFbi2JDmiD2XiKDuaY5ctDnEhwS8WDAfDAnyJSoy2tBAgNvwKCk4tqP9F1yVsi0wkDucw0AAnBJAf0Gy88OAw03yCJ4NfMIf0DvV0TZXv7B6BPqbuH5pAmD1qqKe5kL36RH04ClG+pBbUX1ipgXnN5vqn33jjZJDbm9UqyHa+4M7Caholi546cRj+zSXePakEJ6NPQ8NBOjnD6TIOyO6izp06a7J6P52Fp1lIOiRMxkXJ9gBAAD//+xKIa4AAAAGSURBVAMAmz2PMR1V/7YAAAAASUVORK5CYII=';
     var terrainIcon = 'data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAABgAAAAYCAYAAADgdz34AAABqElEQVR4AdyU4VHDMAyFnzoBbACbwAawAWwAE1AmgA1gA9igbNJuABNEfHZsx65zvVyP/kEn2crTs56T9rTSie2fC7j7mvAhLO53h74mlDNiQ3zUvO4TQXjw1BLiEyELi/TmkxUxIC4xOJRv4kryG/bijQBkp/JCKCTsX8TorjpHbIjXgPikfAX11ghMZTtfWbTrjNnKrg3j+VKmnVjim5mC8Dml+ChwVdYLcHXIPxWnSantiMsMkgfhik+DXGTvBQCP9tg7vUhq0gu09USb22K3tjBzthdojxx4mukWNeNSzi0QcP4ohb8gaYUXCNje/2KBRkVZIFCxj0gXCLTftNaYr7ToAgGrezb5fKVFe4H2AjTsALDRu0rbO5J6gURiLsXpqPQTM3i2YBcq5qkyAtTOxqxdewGXnG7Q8nQkjR6abwfHBt+I9lDhOiMaVAp8cZqYvBeItfQa0rMx5Zg3JtN9KNm4XI1bWEUeUWGPBp+9+L7Ap0xlOtJ4rWTk70R0oHsiO5cw2sbSawbz3ghAuSX2pmOmTjucIkZeLjExpqwRmOC/y04u8AsAAP//3EypAQAAAAZJREFUAwCgdJgxQLeyzwAAAABJRU5ErkJggg==';
     var gradeIcon = 'data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAABgAAAAYCAYAAADgdz34AAAB30lEQVR4AcyUi1XsMAxEpa2AEnY74nXw6IAOgAooATqAEuhk6QAqwNwZO04M4bN8zsHHlmRFmrGlJJv45fH3CUop2/eK8K0bAH4F+B59jPbEPrLRxJcJADoF4z9L806irYemrb5EALjKcmmEiF1mPsrGXyKY2rR1MAEgR+TuG9AF4PfsAz8+WeM6mID0VoK8BfycvcBvOPf2xeH1KN4k4ESlPJV5TLbSStwD/i8YBEBSjhM7ZqGd1yoBSXo7oiaU8HCyrchN7mQRp16cRQ3cfeoGLclvR3psLCehXTCIq72o/LUXPkR1EOK5dgOa5aATR7wtHhyV0XsRHmaxJTEQcCrA5U7V+FoWvtUZ1CMjFOdehIYZLbTz6gSgqCx+EyjHVOPaC4Uu82xnTHF67JWWg+gEeOvXmDGBq4EiDYCSxlpZqBEY5KzMkaUTEK/rotIfDpl7qoCKj3qhmMXy9fq+E3QPBuXatzCRXuM6YOYQ+4oA8FMauFUYZXG5howPN+1oLe4VAWW5bM8OBx+xDTMQ6G9gb+j8of88F5IXtZx2WZTl76SmVYRJdoJSypVh25P5MCteu5LLEmwbremkpSPmnx2vzwkrqftS2Z5Fez+bY9zhbA5xTavfYHL8tP51gmcAAAD//2tJwoIAAAAGSURBVAMAu73qMUTY1OoAAAAASUVORK5CYII=';
@@ -158,9 +326,12 @@
       '.icon-label{display:flex;align-items:center;gap:6px;}' +
       '.icon-label img{width:14px;height:14px;display:inline-block;filter:brightness(0) invert(1);}' +
       '.icon-chip{display:inline-flex;align-items:center;justify-content:center;width:18px;height:18px;border-radius:4px;background:#111;}' +
-      'input,select{width:100%;padding:8px;font-size:14px;box-sizing:border-box;}' +
+      'input,select,textarea{width:100%;padding:8px;font-size:14px;box-sizing:border-box;}' +
       '.row{display:flex;gap:8px;}.row>div{flex:1;}' +
       '.card{background:#fff;border-radius:8px;padding:12px;margin-top:10px;}' +
+      'canvas{display:block;width:100%;height:110px;margin-top:4px;}' +
+      '#history_list{height:256px;overflow-y:auto;-webkit-overflow-scrolling:touch;margin-top:10px;border-top:1px solid #ddd;}' +
+      '.vrow{position:absolute;left:0;right:0;height:32px;line-height:32px;font-size:13px;white-space:nowrap;overflow:hidden;border-bottom:1px solid #eee;}' +
       '.actions{display:flex;gap:8px;}' +
       '.actions button{margin-top:16px;padding:11px;font-size:16px;color:#fff;border:0;border-radius:6px;}' +
       '#save{flex:2;background:#111;}' +
@@ -177,6 +348,26 @@
       '<label>Stride length</label>' +
       '<div class="row"><div><input type="number" id="stride_length_value" step="0.1"></div>' +
       '<div><select id="stride_length_unit"><option value="0">cm</option><option value="1">in</option></select></div></div>' +
+      '<label>Age / sex (heart-rate energy model)</label>' +
+      '<div class="row"><div><input type="number" id="age_years" step="1"></div>' +
+      '<div><select id="sex"><option value="0">Male</option><option value="1">Female</option></select></div></div>' +
+      '<label>Auto-pause after no steps for (s, 0 = off)</label>' +
+      '<input type="number" id="auto_pause_seconds" step="5" min="0">' +
+      '<label>Planned ruck duration (h, 0 = unknown; sizes battery saving)</label>' +
+      '<input type="number" id="planned_duration_h" step="0.5" min="0">' +
+      '<label>Step source</label>' +
+      '<select id="step_source"><option value="0">Auto (Health, else accelerometer)</option>' +
+      '<option value="1">Accelerometer</option><option value="2">Health, cross-check with accelerometer</option></select>' +
+      '<label>Accelerometer step peak (mg) / min step gap (ms)</label>' +
+      '<div class="row"><div><input type="number" id="accel_threshold_mg" step="5" min="20"></div>' +
+      '<div><input type="number" id="accel_min_step_ms" step="10" min="150"></div></div>' +
+      '<label>Display during a ruck</label>' +
+      '<select id="display_wake_s"><option value="0">Always live</option>' +
+      '<option value="10">Tap to wake, 10 s</option><option value="20">Tap to wake, 20 s</option>' +
+      '<option value="30">Tap to wake, 30 s</option></select>' +
+      '<label>Ghost pace: race a previous ruck on the same profile</label>' +
+      '<select id="ghost_mode"><option value="0">Off</option><option value="1">Last ruck</option>' +
+      '<option value="2">Best ruck</option></select>' +
       '</div>' +
 
       '<div class="card"><h2>Profile 1</h2>' +
@@ -184,6 +375,11 @@
       '<label id="p1_ruck_weight_label" class="icon-label"><span>Ruck weight (kg)</span><span class="icon-chip"><img src="' + weightIcon + '" alt=""></span></label><input type="number" id="p1_ruck_weight_value" step="0.1">' +
       '<label class="icon-label"><span>Terrain</span><span class="icon-chip"><img src="' + terrainIcon + '" alt=""></span></label><select id="p1_terrain_type">' + terrainOptions + '</select>' +
       '<label class="icon-label"><span>Grade (%)</span><span class="icon-chip"><img src="' + gradeIcon + '" alt=""></span></label><input type="number" id="p1_grade_percent" step="1">' +
+      '<label>Energy model</label><select id="p1_energy_model">' + energyModelOptions + '</select>' +
+      '<label>Pacer: cadence (steps/min) or target pace (m:ss per km or mile, follows body weight unit)</label>' +
+      '<div class="row"><div><input type="number" id="p1_pacer_spm" step="1" min="0" placeholder="off"></div>' +
+      '<div><input type="text" id="p1_pacer_pace" placeholder="off"></div></div>' +
+      routeFieldsHtml(1) +
       '</div>' +
 
       '<div class="card"><h2>Profile 2</h2>' +
@@ -191,6 +387,11 @@
       '<label id="p2_ruck_weight_label" class="icon-label"><span>Ruck weight (kg)</span><span class="icon-chip"><img src="' + weightIcon + '" alt=""></span></label><input type="number" id="p2_ruck_weight_value" step="0.1">' +
       '<label class="icon-label"><span>Terrain</span><span class="icon-chip"><img src="' + terrainIcon + '" alt=""></span></label><select id="p2_terrain_type">' + terrainOptions + '</select>' +
       '<label class="icon-label"><span>Grade (%)</span><span class="icon-chip"><img src="' + gradeIcon + '" alt=""></span></label><input type="number" id="p2_grade_percent" step="1">' +
+      '<label>Energy model</label><select id="p2_energy_model">' + energyModelOptions + '</select>' +
+      '<label>Pacer: cadence (steps/min) or target pace (m:ss per km or mile, follows body weight unit)</label>' +
+      '<div class="row"><div><input type="number" id="p2_pacer_spm" step="1" min="0" placeholder="off"></div>' +
+      '<div><input type="text" id="p2_pacer_pace" placeholder="off"></div></div>' +
+      routeFieldsHtml(2) +
       '</div>' +
 
       '<div class="card"><h2>Profile 3</h2>' +
@@ -198,6 +399,17 @@
       '<label id="p3_ruck_weight_label" class="icon-label"><span>Ruck weight (kg)</span><span class="icon-chip"><img src="' + weightIcon + '" alt=""></span></label><input type="number" id="p3_ruck_weight_value" step="0.1">' +
       '<label class="icon-label"><span>Terrain</span><span class="icon-chip"><img src="' + terrainIcon + '" alt=""></span></label><select id="p3_terrain_type">' + terrainOptions + '</select>' +
       '<label class="icon-label"><span>Grade (%)</span><span class="icon-chip"><img src="' + gradeIcon + '" alt=""></span></label><input type="number" id="p3_grade_percent" step="1">' +
+      '<label>Energy model</label><select id="p3_energy_model">' + energyModelOptions + '</select>' +
+      '<label>Pacer: cadence (steps/min) or target pace (m:ss per km or mile, follows body weight unit)</label>' +
+      '<div class="row"><div><input type="number" id="p3_pacer_spm" step="1" min="0" placeholder="off"></div>' +
+      '<div><input type="text" id="p3_pacer_pace" placeholder="off"></div></div>' +
+      routeFieldsHtml(3) +
+      '</div>' +
+
+      '<div class="card"><h2>Workout</h2>' +
+      '<label>Steps, e.g. 10 min easy, 6x(3 min hard @ 9:30, 2 min walk), 5 min easy</label>' +
+      '<textarea id="workout_text" rows="3" maxlength="400"></textarea>' +
+      '<label>Intensities: easy, steady, hard, walk. Pace per km or mile follows the body weight unit. Leave empty for free rucking.</label>' +
       '</div>' +
 
       '<div class="card"><h2>Tracked Totals</h2>' +
@@ -210,6 +422,45 @@
       '<label>Distance (km)</label><input type="text" id="last_activity_distance_km" readonly>' +
       '<label>Pace (min/km)</label><input type="text" id="last_activity_pace" readonly>' +
       '<label>Calories</label><input type="text" id="last_activity_calories_display" readonly>' +
+      '<label>Time in heart-rate zones (Z1-Z5)</label><input type="text" id="last_activity_hr_zones" readonly>' +
+      '<label>Time by grade (&lt;-6, -6..-2, flat, 2..6, 6..10, &gt;10 %)</label><input type="text" id="last_activity_grades" readonly>' +
+      '</div>' +
+
+      '<div class="card"><h2>History</h2>' +
+      '<div id="history_summary"></div>' +
+      '<label>Distance per week</label><canvas id="history_volume"></canvas>' +
+      '<label>Pace trend (mean and range)</label><canvas id="history_pace"></canvas>' +
+      '<div id="history_list"></div>' +
+      '</div>' +
+
+      '<div class="card"><h2>Stride calibration</h2>' +
+      '<label>Last recorded ruck</label><input type="text" id="stride_last" readonly>' +
+      '<label>Its distance measured by GPS (km), refits that profile&#39;s stride by cadence</label>' +
+      '<input type="number" id="stride_measured_km" step="0.01" min="0">' +
+      '<label>Reset stride table to the fixed stride for</label><select id="stride_reset">' +
+      '<option value="0">Nothing</option>' +
+      '<option value="1">Profile 1</option><option value="2">Profile 2</option><option value="3">Profile 3</option>' +
+      '</select>' +
+      '</div>' +
+
+      '<div class="card"><h2>Recalculate</h2>' +
+      '<label>Re-run calories with these settings for</label><select id="recalculate">' +
+      '<option value="0">Nothing</option>' +
+      '<option value="1">Current session</option>' +
+      '<option value="2">Last saved session</option>' +
+      '</select>' +
+      '</div>' +
+
+      '<div class="card"><h2>Replay (testing)</h2>' +
+      '<label>Trace</label><select id="replay_trace">' +
+      '<option value="">Off</option>' +
+      '<option value="builtin">Built-in 10 h ruck</option>' +
+      '<option value="synthetic">Generated 10 h ruck (phone)</option>' +
+      '<option value="stop_and_go">Stop and go (file)</option>' +
+      '</select>' +
+      '<label>Speed-up</label><select id="replay_speed">' +
+      '<option value="60">60x</option><option value="600">600x</option><option value="3600">3600x</option>' +
+      '</select>' +
       '</div>' +
 
       '<div class="actions">' +
@@ -224,6 +475,16 @@
       'if(factor<=125){return "gravel";}' +
       'if(factor<=140){return "mixed";}' +
       'return "sand";}' +
+      // The watch keeps pacer targets in seconds per km; the page shows the body weight unit.
+      'function paceToTextInner(sec,mi){' +
+      'if(!sec){return "";}' +
+      'var s=Math.round(mi?sec*1.609344:sec);' +
+      'return Math.floor(s/60)+":"+("0"+(s%60)).slice(-2);}' +
+      'function paceFromTextInner(text,mi){' +
+      'var m=/^\\s*(\\d+):(\\d{1,2})\\s*$/.exec(text||"");' +
+      'if(!m){return 0;}' +
+      'var s=parseInt(m[1],10)*60+parseInt(m[2],10);' +
+      'return Math.round(mi?s/1.609344:s);}' +
       'function updateRuckWeightLabels(){' +
       'var unit=($("ruck_weight_unit").value==="1")?"lb":"kg";' +
       '$("p1_ruck_weight_label").querySelector("span").textContent="Ruck weight ("+unit+")";' +
@@ -255,18 +516,40 @@
       '$("ruck_weight_unit").value=cfg.ruck_weight_unit;' +
       '$("stride_length_value").value=(cfg.stride_length_value/10).toFixed(1);' +
       '$("stride_length_unit").value=cfg.stride_length_unit;' +
+      '$("age_years").value=cfg.age_years;' +
+      '$("sex").value=cfg.sex;' +
+      '$("auto_pause_seconds").value=cfg.auto_pause_seconds;' +
+      '$("planned_duration_h").value=(cfg.planned_duration_min||0)/60;' +
+      '$("step_source").value=cfg.step_source||0;' +
+      '$("accel_threshold_mg").value=cfg.accel_threshold_mg;' +
+      '$("accel_min_step_ms").value=cfg.accel_min_step_ms;' +
+      '$("display_wake_s").value=cfg.display_wake_s||0;' +
+      '$("ghost_mode").value=cfg.ghost_mode||0;' +
+      '$("workout_text").value=cfg.workout_text||"";' +
       '$("p1_ruck_weight_value").value=(cfg.profile1_ruck_weight_value/10).toFixed(1);' +
       '$("p1_terrain_type").value=terrainTypeFromSettingsInner(cfg.profile1_terrain_type,cfg.profile1_terrain_factor);' +
       '$("p1_grade_percent").value=Math.round(cfg.profile1_grade_percent/10);' +
       '$("p1_name").value=cfg.profile1_name||"";' +
+      '$("p1_energy_model").value=cfg.profile1_energy_model||0;' +
+      '$("p1_pacer_spm").value=cfg.profile1_pacer_spm||"";' +
+      '$("p1_pacer_pace").value=paceToTextInner(cfg.profile1_pacer_pace_s,cfg.weight_unit===1);' +
+      '$("p1_route_summary").value=cfg.profile1_route_summary||"";' +
       '$("p2_ruck_weight_value").value=(cfg.profile2_ruck_weight_value/10).toFixed(1);' +
       '$("p2_terrain_type").value=terrainTypeFromSettingsInner(cfg.profile2_terrain_type,cfg.profile2_terrain_factor);' +
       '$("p2_grade_percent").value=Math.round(cfg.profile2_grade_percent/10);' +
       '$("p2_name").value=cfg.profile2_name||"";' +
+      '$("p2_energy_model").value=cfg.profile2_energy_model||0;' +
+      '$("p2_pacer_spm").value=cfg.profile2_pacer_spm||"";' +
+      '$("p2_pacer_pace").value=paceToTextInner(cfg.profile2_pacer_pace_s,cfg.weight_unit===1);' +
+      '$("p2_route_summary").value=cfg.profile2_route_summary||"";' +
       '$("p3_ruck_weight_value").value=(cfg.profile3_ruck_weight_value/10).toFixed(1);' +
       '$("p3_terrain_type").value=terrainTypeFromSettingsInner(cfg.profile3_terrain_type,cfg.profile3_terrain_factor);' +
       '$("p3_grade_percent").value=Math.round(cfg.profile3_grade_percent/10);' +
       '$("p3_name").value=cfg.profile3_name||"";' +
+      '$("p3_energy_model").value=cfg.profile3_energy_model||0;' +
+      '$("p3_pacer_spm").value=cfg.profile3_pacer_spm||"";' +
+      '$("p3_pacer_pace").value=paceToTextInner(cfg.profile3_pacer_pace_s,cfg.weight_unit===1);' +
+      '$("p3_route_summary").value=cfg.profile3_route_summary||"";' +
       '$("lifetime_distance_km_total").value=formatKmFromMeters(cfg.lifetime_distance_m_total);' +
       '$("lifetime_calories_total").value=formatNumber(cfg.lifetime_calories_total);' +
       'var ts=parseInt(cfg.last_activity_timestamp,10)||0;' +
@@ -275,9 +558,42 @@
       'var ps=parseInt(cfg.last_activity_pace_sec,10)||0;' +
       '$("last_activity_pace").value=ps>0?Math.floor(ps/60)+":"+(("0"+(ps%60)).slice(-2)):"--";' +
       '$("last_activity_calories_display").value=formatNumber(cfg.last_activity_calories||0);' +
+      'var hist=cfg.last_activity_histograms;' +
+      'function minutes(bins){return bins.map(function(v){return Math.round(v/60)+"m";}).join(" ");}' +
+      '$("last_activity_hr_zones").value=hist&&hist.hr_zone?minutes(hist.hr_zone.slice(1)):"--";' +
+      '$("last_activity_grades").value=hist&&hist.grade?minutes(hist.grade):"--";' +
+      'var cal=(cfg.stride_calibrations||[])[0];' +
+      '$("stride_last").value=cal?"Profile "+(cal.profile+1)+", "+new Date(cal.start_time*1000).toLocaleString()+", watch "+formatKmFromMeters(cal.distance_m)+" km":"--";' +
+      '$("stride_measured_km").value=cal&&cal.measured_m?(cal.measured_m/1000).toFixed(2):"";' +
+      '$("stride_measured_km").disabled=!cal;' +
       'updateRuckWeightLabels();' +
       '}' +
       'applyToForm(s);' +
+      // Indentation would triple in the URL-encoded page; the line breaks keep the code valid.
+      'var showHistory=' + history.showHistory.toString().replace(/\n\s+/g, '\n') + ';' +
+      'showHistory(' + JSON.stringify(history.blob()) + ',s.weight_unit===1);' +
+      'var reduceGpx=' + route.reduceGpx.toString() + ';' +
+      workout.pageSource() +
+      'var routeUpdates={};' +
+      'function bindRoute(n){' +
+      'var summary=$("p"+n+"_route_summary");' +
+      '$("p"+n+"_route_file").addEventListener("change",function(e){' +
+      'var f=e.target.files&&e.target.files[0];if(!f){return;}' +
+      'var reader=new FileReader();' +
+      'reader.onload=function(){' +
+      'try{' +
+      'var r=reduceGpx(String(reader.result),' + route.MAX_SEGMENTS + ');' +
+      'summary.value=(r.distance_m/1000).toFixed(1)+" km, +"+r.climb_m+"/-"+r.descent_m+" m, "+r.segments.length+" seg";' +
+      'routeUpdates[n]={profile:n-1,segments:r.segments,summary:summary.value};' +
+      '}catch(err){summary.value="";alert("GPX import failed: "+err.message);}' +
+      '};' +
+      'reader.readAsText(f);' +
+      '});' +
+      '$("p"+n+"_route_clear").addEventListener("click",function(){' +
+      'routeUpdates[n]={profile:n-1,segments:[],summary:""};summary.value="";$("p"+n+"_route_file").value="";' +
+      '});' +
+      '}' +
+      'bindRoute(1);bindRoute(2);bindRoute(3);' +
       '$("ruck_weight_unit").addEventListener("change",updateRuckWeightLabels);' +
       '$("reset_defaults").addEventListener("click",function(){' +
       's=Object.assign({},d);' +
@@ -286,38 +602,70 @@
       '});' +
 
       'document.getElementById("save").addEventListener("click",function(){' +
+      'try{workout.compile(($("workout_text").value||"").trim(),$("weight_unit").value==="1");}' +
+      'catch(err){alert("Workout not saved: "+err.message);$("workout_text").focus();return;}' +
       'var out={' +
       'weight_value: Math.round(parseFloat($("weight_value").value||0)*10),' +
       'weight_unit: parseInt($("weight_unit").value,10),' +
       'ruck_weight_unit: parseInt($("ruck_weight_unit").value,10),' +
       'stride_length_value: Math.round(parseFloat($("stride_length_value").value||0)*10),' +
       'stride_length_unit: parseInt($("stride_length_unit").value,10),' +
+      'age_years: parseInt($("age_years").value,10)||35,' +
+      'sex: parseInt($("sex").value,10)||0,' +
+      'auto_pause_seconds: Math.max(0,parseInt($("auto_pause_seconds").value,10)||0),' +
+      'planned_duration_min: Math.max(0,Math.round((parseFloat($("planned_duration_h").value)||0)*60)),' +
+      'step_source: parseInt($("step_source").value,10)||0,' +
+      'accel_threshold_mg: Math.max(20,parseInt($("accel_threshold_mg").value,10)||90),' +
+      'accel_min_step_ms: Math.max(150,parseInt($("accel_min_step_ms").value,10)||280),' +
+      'display_wake_s: Math.max(0,parseInt($("display_wake_s").value,10)||0),' +
+      'ghost_mode: parseInt($("ghost_mode").value,10)||0,' +
+      'workout_text: ($("workout_text").value||"").trim().slice(0,400),' +
 
       'profile1_ruck_weight_value: Math.round(parseFloat($("p1_ruck_weight_value").value||0)*10),' +
       'profile1_terrain_type: $("p1_terrain_type").value,' +
       'profile1_terrain_factor: terrainFactorFromType($("p1_terrain_type").value),' +
       'profile1_grade_percent: (parseInt($("p1_grade_percent").value,10)||0)*10,' +
       'profile1_name: ($("p1_name").value||"").trim().slice(0,32),' +
+      'profile1_energy_model: parseInt($("p1_energy_model").value,10)||0,' +
+      'profile1_pacer_spm: Math.max(0,parseInt($("p1_pacer_spm").value,10)||0),' +
+      'profile1_pacer_pace_s: paceFromTextInner($("p1_pacer_pace").value,$("weight_unit").value==="1"),' +
+      'profile1_route_summary: $("p1_route_summary").value,' +
 
       'profile2_ruck_weight_value: Math.round(parseFloat($("p2_ruck_weight_value").value||0)*10),' +
       'profile2_terrain_type: $("p2_terrain_type").value,' +
       'profile2_terrain_factor: terrainFactorFromType($("p2_terrain_type").value),' +
       'profile2_grade_percent: (parseInt($("p2_grade_percent").value,10)||0)*10,' +
       'profile2_name: ($("p2_name").value||"").trim().slice(0,32),' +
+      'profile2_energy_model: parseInt($("p2_energy_model").value,10)||0,' +
+      'profile2_pacer_spm: Math.max(0,parseInt($("p2_pacer_spm").value,10)||0),' +
+      'profile2_pacer_pace_s: paceFromTextInner($("p2_pacer_pace").value,$("weight_unit").value==="1"),' +
+      'profile2_route_summary: $("p2_route_summary").value,' +
 
       'profile3_ruck_weight_value: Math.round(parseFloat($("p3_ruck_weight_value").value||0)*10),' +
       'profile3_terrain_type: $("p3_terrain_type").value,' +
       'profile3_terrain_factor: terrainFactorFromType($("p3_terrain_type").value),' +
       'profile3_grade_percent: (parseInt($("p3_grade_percent").value,10)||0)*10,' +
       'profile3_name: ($("p3_name").value||"").trim().slice(0,32),' +
+      'profile3_energy_model: parseInt($("p3_energy_model").value,10)||0,' +
+      'profile3_pacer_spm: Math.max(0,parseInt($("p3_pacer_spm").value,10)||0),' +
+      'profile3_pacer_pace_s: paceFromTextInner($("p3_pacer_pace").value,$("weight_unit").value==="1"),' +
+      'profile3_route_summary: $("p3_route_summary").value,' +
       'lifetime_distance_m_total: (s.lifetime_distance_m_total||0),' +
       'lifetime_calories_total: parseInt($("lifetime_calories_total").value,10)||0,' +
       'last_activity_distance_m: (s.last_activity_distance_m||0),' +
       'last_activity_calories: (s.last_activity_calories||0),' +
       'last_activity_pace_sec: (s.last_activity_pace_sec||0),' +
       'last_activity_timestamp: (s.last_activity_timestamp||0),' +
+      'last_activity_histograms: (s.last_activity_histograms||null),' +
+      'stride_calibrations: (s.stride_calibrations||[]),' +
+      'stride_measured_m: Math.max(0,Math.round((parseFloat($("stride_measured_km").value)||0)*1000)),' +
+      'stride_reset: parseInt($("stride_reset").value,10)||0,' +
       'sim_steps_enabled: (s.sim_steps_enabled?1:0),' +
-      'sim_steps_spm: (s.sim_steps_spm||122)' +
+      'sim_steps_spm: (s.sim_steps_spm||122),' +
+      'route_updates: Object.keys(routeUpdates).map(function(k){return routeUpdates[k];}),' +
+      'replay_trace: $("replay_trace").value,' +
+      'replay_speed: parseInt($("replay_speed").value,10)||60,' +
+      'recalculate: parseInt($("recalculate").value,10)||0' +
       '};' +
       'var payload=encodeURIComponent(JSON.stringify(out));' +
       'var ret=queryParam("return_to");' +
@@ -339,12 +687,56 @@
 
   Pebble.addEventListener('ready', function() {
     console.log('ready: syncing settings to watch');
+    // Totals are pushed by the watch whenever a session is committed; the config page still asks
+    // for a fresh copy when it opens.
     syncSettingsToWatch(loadSettings());
-    requestLifetimeTotals();
   });
 
+  // SessionHistograms as stored on the watch: version, per-kind bin counts, 3 reserved bytes,
+  // start time, then every bin as little-endian uint32 seconds in kind order.
+  function decodeHistograms(bytes) {
+    function u32(offset) {
+      return (bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (bytes[offset + 3] << 24)) >>> 0;
+    }
+    if (!bytes || bytes.length < 12 || bytes[0] !== 1) {
+      return null;
+    }
+    var out = { start_time: u32(8) | 0 };
+    var offset = 12;
+    ['hr_zone', 'pace', 'grade', 'load'].forEach(function(kind, index) {
+      var bins = [];
+      for (var i = 0; i < bytes[1 + index] && offset + 4 <= bytes.length; ++i, offset += 4) {
+        bins.push(u32(offset));
+      }
+      out[kind] = bins;
+    });
+    return out;
+  }
+
   Pebble.addEventListener('appmessage', function(e) {
     var payload = (e && e.payload) ? e.payload : {};
+    if (payload.session_histograms) {
+      var hist = decodeHistograms(payload.session_histograms);
+      if (hist) {
+        var stored = loadSettings();
+        stored.last_activity_histograms = hist;
+        saveSettings(stored);
+      }
+    }
+    if (payload.stride_calibration) {
+      var record = stride.decodeCalibration(payload.stride_calibration);
+      if (record) {
+        var current = loadSettings();
+        current.stride_calibrations = stride.addRecord(current.stride_calibrations, record);
+        saveSettings(current);
+      }
+    }
+    if (payload.session_record) {
+      var session = history.decodeRecord(payload.session_record);
+      if (session) {
+        history.record(session);
+      }
+    }
     if (typeof payload.lifetime_distance_m_total === 'number' || typeof payload.lifetime_calories_total === 'number' ||
         typeof payload.last_activity_distance_m === 'number' || typeof payload.last_activity_timestamp === 'number') {
       var s = loadSettings();
@@ -391,7 +783,39 @@
         return;
       }
     }
+    var replayTrace = settings.replay_trace;
+    var replaySpeed = settings.replay_speed;
+    var recalculate = settings.recalculate || 0;
+    var routeUpdates = settings.route_updates || [];
+    var previous = loadSettings();
+    routeUpdates.forEach(function(update) {
+      var key = 'profile' + (update.profile + 1) + '_route_summary';
+      settings[key] = previous[key] || '';
+    });
+    var strideTables = strideUpdates(settings, settings.stride_measured_m || 0, settings.stride_reset || 0);
+    delete settings.stride_measured_m;
+    delete settings.stride_reset;
+    delete settings.recalculate;
+    delete settings.replay_trace;
+    delete settings.replay_speed;
+    delete settings.route_updates;
     console.log('config parsed, sending to watch');
-    syncSettingsToWatch(settings);
+    syncSettingsToWatch(settings, function(settingsSent) {
+      sendRouteUpdates(routeUpdates, function() {
+        sendStrideUpdates(strideTables, function() {
+          function afterRecalculate() {
+            if (replayTrace) {
+              startReplay(replayTrace, replaySpeed);
+            }
+          }
+          // A recalculation with the watch still on the old settings would change nothing.
+          if (recalculate && settingsSent) {
+            requestRecalculation(recalculate, afterRecalculate);
+          } else {
+            afterRecalculate();
+          }
+        });
+      });
+    });
   });
 })();
@@ -0,0 +1,118 @@
+/* Trace replay helpers: synthetic long-ruck workloads and upload to the watch replay engine. */
+var RECORD_BYTES = 6;
+var CHUNK_RECORDS = 96;
+var MAX_RECORDS = 256;
+
+var SOURCE_RESOURCE = 1;
+var SOURCE_UPLOADED = 2;
+
+// Small deterministic PRNG so generated traces are reproducible between runs.
+function makeRng(seed) {
+  var state = seed >>> 0;
+  return function() {
+    state = (state + 0x6D2B79F5) >>> 0;
+    var t = state;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+function clamp(value, lo, hi) {
+  return Math.max(lo, Math.min(hi, value));
+}
+
+// Walking blocks with cadence and grade changes, a slow HR drift for fatigue, and a water stop
+// roughly every 50 minutes. Record count stays under the watch's 256-record upload buffer.
+function generateLongRuck(options) {
+  var opts = options || {};
+  var totalSeconds = Math.round((opts.hours || 10) * 3600);
+  var rand = makeRng(opts.seed || 1);
+  var records = [];
+  var elapsed = 0;
+  var grade = 0;
+  var nextStop = 2700 + Math.floor(rand() * 900);
+  while (elapsed < totalSeconds && records.length < MAX_RECORDS) {
+    var duration;
+    if (elapsed >= nextStop) {
+      duration = 120 + Math.floor(rand() * 180);
+      records.push({ duration_s: duration, cadence_spm: 0, heart_rate_bpm: 92, grade_tenths: 0 });
+      nextStop = elapsed + duration + 2700 + Math.floor(rand() * 900);
+    } else {
+      duration = 120 + Math.floor(rand() * 120);
+      grade = clamp(grade + Math.round((rand() - 0.5) * 60), -80, 100);
+      var cadence = Math.round(108 + rand() * 20);
+      var fatigue = (elapsed / 3600) * 1.5;
+      var hr = Math.round(95 + (cadence - 100) * 1.2 + grade * 0.3 + fatigue);
+      records.push({
+        duration_s: duration,
+        cadence_spm: cadence,
+        heart_rate_bpm: clamp(hr, 60, 200),
+        grade_tenths: grade
+      });
+    }
+    elapsed += duration;
+  }
+  return records;
+}
+
+// Compact JSON traces are arrays of [duration_s, cadence_spm, heart_rate_bpm, grade_tenths].
+function fromCompact(rows) {
+  return rows.map(function(row) {
+    return { duration_s: row[0], cadence_spm: row[1], heart_rate_bpm: row[2], grade_tenths: row[3] };
+  });
+}
+
+function encodeTrace(records) {
+  var bytes = [];
+  records.forEach(function(r) {
+    var grade = r.grade_tenths & 0xFFFF;
+    bytes.push(r.duration_s & 0xFF, (r.duration_s >> 8) & 0xFF,
+               r.cadence_spm & 0xFF, r.heart_rate_bpm & 0xFF,
+               grade & 0xFF, (grade >> 8) & 0xFF);
+  });
+  return bytes;
+}
+
+function startBuiltin(speed) {
+  Pebble.sendAppMessage({ replay_start: SOURCE_RESOURCE, replay_speed: speed }, function() {
+    console.log('replay: built-in trace started x' + speed);
+  }, function(err) {
+    console.log('replay: start failed:', JSON.stringify(err));
+  });
+}
+
+// Uploads whole-record chunks one at a time, then starts the replay from the uploaded buffer.
+function uploadAndStart(records, speed) {
+  var bytes = encodeTrace(records.slice(0, MAX_RECORDS));
+  var chunkBytes = CHUNK_RECORDS * RECORD_BYTES;
+  function sendChunk(offsetRecords) {
+    var start = offsetRecords * RECORD_BYTES;
+    if (start >= bytes.length) {
+      Pebble.sendAppMessage({ replay_start: SOURCE_UPLOADED, replay_speed: speed }, function() {
+        console.log('replay: uploaded trace started x' + speed);
+      }, function(err) {
+        console.log('replay: start failed:', JSON.stringify(err));
+      });
+      return;
+    }
+    Pebble.sendAppMessage({
+      replay_trace_offset: offsetRecords,
+      replay_trace_chunk: bytes.slice(start, start + chunkBytes)
+    }, function() {
+      sendChunk(offsetRecords + CHUNK_RECORDS);
+    }, function(err) {
+      console.log('replay: chunk upload failed at', offsetRecords, JSON.stringify(err));
+    });
+  }
+  sendChunk(0);
+}
+
+module.exports = {
+  RECORD_BYTES: RECORD_BYTES,
+  generateLongRuck: generateLongRuck,
+  fromCompact: fromCompact,
+  encodeTrace: encodeTrace,
+  startBuiltin: startBuiltin,
+  uploadAndStart: uploadAndStart
+};
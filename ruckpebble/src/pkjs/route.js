@@ -0,0 +1,184 @@
+/* Route grade profiles: GPX track -> compact distance/grade segment table for the watch. */
+var SEGMENT_BYTES = 4;
+var MAX_SEGMENTS = 60;
+
+// Self-contained so the config page can embed it with Function.prototype.toString(); the page
+// reduces the GPX locally and only the segment table travels back to pkjs.
+function reduceGpx(gpxText, maxSegments) {
+  var EARTH_RADIUS_M = 6371000;
+  var RESAMPLE_M = 20;
+  var SMOOTH_SAMPLES = 5;
+  var MAX_GRADE_TENTHS = 400;
+  var limit = maxSegments || 60;
+
+  var points = [];
+  var trkpt = /<trkpt\b[^>]*\blat="([-\d.]+)"[^>]*\blon="([-\d.]+)"[^>]*>([\s\S]*?)<\/trkpt>/g;
+  var trkptLonFirst = /<trkpt\b[^>]*\blon="([-\d.]+)"[^>]*\blat="([-\d.]+)"[^>]*>([\s\S]*?)<\/trkpt>/g;
+  var match;
+  while ((match = trkpt.exec(gpxText)) !== null) {
+    points.push([parseFloat(match[1]), parseFloat(match[2]), match[3]]);
+  }
+  if (points.length === 0) {
+    while ((match = trkptLonFirst.exec(gpxText)) !== null) {
+      points.push([parseFloat(match[2]), parseFloat(match[1]), match[3]]);
+    }
+  }
+  var track = [];
+  points.forEach(function(p) {
+    var ele = /<ele>\s*([-\d.]+)\s*<\/ele>/.exec(p[2]);
+    if (ele) {
+      track.push({ lat: p[0], lon: p[1], ele: parseFloat(ele[1]) });
+    }
+  });
+  if (track.length < 2) {
+    throw new Error('GPX has no track points with elevation');
+  }
+
+  function toRad(deg) {
+    return deg * Math.PI / 180;
+  }
+  function haversine(a, b) {
+    var dLat = toRad(b.lat - a.lat);
+    var dLon = toRad(b.lon - a.lon);
+    var h = Math.sin(dLat / 2) * Math.sin(dLat / 2) +
+      Math.cos(toRad(a.lat)) * Math.cos(toRad(b.lat)) * Math.sin(dLon / 2) * Math.sin(dLon / 2);
+    return 2 * EARTH_RADIUS_M * Math.asin(Math.min(1, Math.sqrt(h)));
+  }
+
+  // Cumulative distance, then resample elevation on a fixed grid and smooth GPS/baro noise.
+  var dist = [0];
+  for (var i = 1; i < track.length; i++) {
+    dist.push(dist[i - 1] + haversine(track[i - 1], track[i]));
+  }
+  var total = dist[dist.length - 1];
+  if (total < RESAMPLE_M) {
+    throw new Error('GPX track is too short');
+  }
+  var grid = [];
+  var j = 0;
+  for (var d = 0; d <= total; d += RESAMPLE_M) {
+    while (j < dist.length - 2 && dist[j + 1] < d) {
+      j++;
+    }
+    var span = dist[j + 1] - dist[j];
+    var t = span > 0 ? (d - dist[j]) / span : 0;
+    grid.push({ d: d, ele: track[j].ele + (track[j + 1].ele - track[j].ele) * Math.max(0, Math.min(1, t)) });
+  }
+  grid.push({ d: total, ele: track[track.length - 1].ele });
+  var half = Math.floor(SMOOTH_SAMPLES / 2);
+  var smooth = grid.map(function(g, k) {
+    var sum = 0;
+    var n = 0;
+    for (var m = Math.max(0, k - half); m <= Math.min(grid.length - 1, k + half); m++) {
+      sum += grid[m].ele;
+      n++;
+    }
+    return { d: g.d, ele: sum / n };
+  });
+
+  // Douglas-Peucker on (distance, elevation), loosening the tolerance until the table fits.
+  function simplify(epsilon) {
+    var keep = new Array(smooth.length);
+    keep[0] = keep[smooth.length - 1] = true;
+    var stack = [[0, smooth.length - 1]];
+    while (stack.length) {
+      var range = stack.pop();
+      var a = smooth[range[0]];
+      var b = smooth[range[1]];
+      var slope = (b.ele - a.ele) / Math.max(1e-6, b.d - a.d);
+      var worst = -1;
+      var worstErr = epsilon;
+      for (var k = range[0] + 1; k < range[1]; k++) {
+        var err = Math.abs(smooth[k].ele - (a.ele + slope * (smooth[k].d - a.d)));
+        if (err > worstErr) {
+          worst = k;
+          worstErr = err;
+        }
+      }
+      if (worst >= 0) {
+        keep[worst] = true;
+        stack.push([range[0], worst], [worst, range[1]]);
+      }
+    }
+    return smooth.filter(function(_, k) { return keep[k]; });
+  }
+
+  var epsilon = 0.5;
+  var vertices;
+  var segments;
+  do {
+    vertices = simplify(epsilon);
+    segments = [];
+    for (var v = 1; v < vertices.length; v++) {
+      var length = vertices[v].d - vertices[v - 1].d;
+      var grade = Math.round((vertices[v].ele - vertices[v - 1].ele) / length * 1000);
+      grade = Math.max(-MAX_GRADE_TENTHS, Math.min(MAX_GRADE_TENTHS, grade));
+      var remaining = Math.round(length);
+      while (remaining > 0) {
+        var piece = Math.min(remaining, 65535);
+        var last = segments[segments.length - 1];
+        if (last && last.grade_tenths === grade && last.length_m + piece <= 65535) {
+          last.length_m += piece;
+        } else {
+          segments.push({ length_m: piece, grade_tenths: grade });
+        }
+        remaining -= piece;
+      }
+    }
+    epsilon *= 1.5;
+  } while (segments.length > limit);
+
+  var climb = 0;
+  var descent = 0;
+  segments.forEach(function(s) {
+    var rise = s.length_m * s.grade_tenths / 1000;
+    if (rise > 0) {
+      climb += rise;
+    } else {
+      descent -= rise;
+    }
+  });
+  return {
+    segments: segments,
+    distance_m: Math.round(total),
+    climb_m: Math.round(climb),
+    descent_m: Math.round(descent)
+  };
+}
+
+function encodeSegments(segments) {
+  var bytes = [];
+  (segments || []).slice(0, MAX_SEGMENTS).forEach(function(s) {
+    var length = Math.max(0, Math.min(65535, s.length_m | 0));
+    var grade = (s.grade_tenths | 0) & 0xFFFF;
+    bytes.push(length & 0xFF, (length >> 8) & 0xFF, grade & 0xFF, (grade >> 8) & 0xFF);
+  });
+  return bytes;
+}
+
+// Sends one profile's table; an empty list clears the route on the watch. onDone gets whether
+// the watch acknowledged it.
+function sendToWatch(profileIndex, segments, onDone) {
+  Pebble.sendAppMessage({
+    route_profile: profileIndex,
+    route_segments: encodeSegments(segments)
+  }, function() {
+    console.log('route: profile ' + (profileIndex + 1) + ' sent, ' + (segments || []).length + ' segments');
+    if (onDone) {
+      onDone(true);
+    }
+  }, function(err) {
+    console.log('route: send failed:', JSON.stringify(err));
+    if (onDone) {
+      onDone(false);
+    }
+  });
+}
+
+module.exports = {
+  SEGMENT_BYTES: SEGMENT_BYTES,
+  MAX_SEGMENTS: MAX_SEGMENTS,
+  reduceGpx: reduceGpx,
+  encodeSegments: encodeSegments,
+  sendToWatch: sendToWatch
+};
@@ -0,0 +1,138 @@
+/* Cadence-dependent stride tables: fitted on the phone from sessions with a measured distance. */
+var KNOTS = 8;
+var CADENCE_MIN_SPM = 80;         // STRIDE_CADENCE_MIN_SPM / STRIDE_CADENCE_STEP_SPM on the watch
+var CADENCE_STEP_SPM = 10;
+var CADENCE_CENTRE_SPM = 115;
+var MIN_STRIDE_MM = 300;
+var MAX_STRIDE_MM = 1500;
+var MAX_RECORDS = 12;
+// Ridge weights in sessions: a single measured ruck moves the level almost all the way, while
+// the slope needs rucks at different cadences before it leaves zero.
+var PRIOR_LEVEL_WEIGHT = 0.05;
+var PRIOR_SLOPE_WEIGHT = 5;
+
+// StrideCalibration as sent by the watch: version, profile, knot count, reserved byte, start
+// time, watch distance in m, then steps per cadence band as little-endian uint32.
+function decodeCalibration(bytes) {
+  function u32(offset) {
+    return (bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (bytes[offset + 3] << 24)) >>> 0;
+  }
+  if (!bytes || bytes.length < 12 || bytes[0] !== 1) {
+    return null;
+  }
+  var bands = [];
+  for (var k = 0; k < bytes[2] && 12 + 4 * k + 4 <= bytes.length; ++k) {
+    bands.push(u32(12 + 4 * k));
+  }
+  return {
+    profile: bytes[1],
+    start_time: u32(4) | 0,
+    distance_m: u32(8) | 0,
+    band_steps: bands,
+    measured_m: 0
+  };
+}
+
+// Newest first; a record for the same session replaces the old one but keeps its measurement.
+function addRecord(records, record) {
+  var out = [record];
+  (records || []).forEach(function(r) {
+    if (r.start_time === record.start_time) {
+      record.measured_m = record.measured_m || r.measured_m;
+    } else {
+      out.push(r);
+    }
+  });
+  return out.slice(0, MAX_RECORDS);
+}
+
+function strideFromSettings(settings) {
+  var value = settings.stride_length_value || 0;
+  return settings.stride_length_unit === 1 ? value * 2.54 : value;
+}
+
+// Least squares of stride = a + b * (cadence - 115) over the measured sessions of one profile,
+// each summarised as its mean stride and mean cadence offset, regularised toward the configured
+// stride and a flat slope. Returns the knot table in mm, or null with nothing to fit.
+function fit(records, profileIndex, priorStrideMm) {
+  var n = 0;
+  var sm = 0;
+  var smm = 0;
+  var sy = 0;
+  var smy = 0;
+  (records || []).forEach(function(r) {
+    if (r.profile !== profileIndex || !(r.measured_m > 0)) {
+      return;
+    }
+    var steps = 0;
+    var offset = 0;
+    r.band_steps.forEach(function(count, k) {
+      steps += count;
+      offset += count * (CADENCE_MIN_SPM + k * CADENCE_STEP_SPM - CADENCE_CENTRE_SPM);
+    });
+    if (steps <= 0) {
+      return;
+    }
+    var m = offset / steps;
+    var y = r.measured_m * 1000 / steps;
+    n += 1;
+    sm += m;
+    smm += m * m;
+    sy += y;
+    smy += m * y;
+  });
+  if (n === 0) {
+    return null;
+  }
+  var a11 = n + PRIOR_LEVEL_WEIGHT;
+  var a12 = sm;
+  var a22 = smm + PRIOR_SLOPE_WEIGHT;
+  var b1 = sy + PRIOR_LEVEL_WEIGHT * priorStrideMm;
+  var b2 = smy;
+  var det = a11 * a22 - a12 * a12;
+  var level = (b1 * a22 - a12 * b2) / det;
+  var slope = (a11 * b2 - a12 * b1) / det;
+  var knots = [];
+  for (var k = 0; k < KNOTS; ++k) {
+    var stride = level + slope * (CADENCE_MIN_SPM + k * CADENCE_STEP_SPM - CADENCE_CENTRE_SPM);
+    knots.push(Math.round(Math.max(MIN_STRIDE_MM, Math.min(MAX_STRIDE_MM, stride))));
+  }
+  return knots;
+}
+
+function encodeTable(knots) {
+  var bytes = [];
+  (knots || []).slice(0, KNOTS).forEach(function(mm) {
+    bytes.push(mm & 0xFF, (mm >> 8) & 0xFF);
+  });
+  return bytes;
+}
+
+// Sends one profile's table; an empty table puts the profile back on the constant stride. onDone
+// gets whether the watch acknowledged it.
+function sendToWatch(profileIndex, knots, onDone) {
+  Pebble.sendAppMessage({
+    stride_profile: profileIndex,
+    stride_table: encodeTable(knots)
+  }, function() {
+    console.log('stride: profile ' + (profileIndex + 1) + ' sent, ' + (knots ? knots.join('/') : 'cleared'));
+    if (onDone) {
+      onDone(true);
+    }
+  }, function(err) {
+    console.log('stride: send failed:', JSON.stringify(err));
+    if (onDone) {
+      onDone(false);
+    }
+  });
+}
+
+module.exports = {
+  KNOTS: KNOTS,
+  decodeCalibration: decodeCalibration,
+  addRecord: addRecord,
+  strideFromSettings: strideFromSettings,
+  fit: fit,
+  encodeTable: encodeTable,
+  sendToWatch: sendToWatch
+};
@@ -0,0 +1,165 @@
+/* Interval workout compiler: text definitions from the config page to the watch step program. */
+var INSTR_BYTES = 6;
+var MAX_INSTR = 40;
+
+var OP_END = 0;
+var OP_STEP = 1;
+var OP_REPEAT = 2;
+
+var INTENSITIES = { easy: 0, steady: 1, hard: 2, walk: 3, rest: 3, recover: 3 };
+var METERS_PER_MILE = 1609.344;
+
+// Grammar, comma separated:
+//   step   := <duration> <intensity> [@ m:ss]     e.g. "3 min hard @ 9:30", "90s walk"
+//   repeat := <count> x ( <steps> )               e.g. "6x(3m hard @9:30, 2m walk)"
+// Pace is per mile when imperial is set, per km otherwise.
+function tokenize(text) {
+  var tokens = [];
+  var re = /\s*(\d+(?::\d{1,2})?|[a-z]+|[(),@x×])/gi;
+  var match;
+  var pos = 0;
+  var src = String(text || '').toLowerCase();
+  while (pos < src.length) {
+    re.lastIndex = pos;
+    match = re.exec(src);
+    if (!match || match.index !== pos) {
+      if (/^\s*$/.test(src.slice(pos))) {
+        break;
+      }
+      throw new Error('unexpected "' + src.slice(pos, pos + 8).trim() + '"');
+    }
+    tokens.push(match[1] === '×' ? 'x' : match[1]);
+    pos = re.lastIndex;
+  }
+  return tokens;
+}
+
+function parseDurationUnit(token) {
+  if (!token) {
+    return 60;
+  }
+  if (/^(s|sec|secs|second|seconds)$/.test(token)) {
+    return 1;
+  }
+  if (/^(m|min|mins|minute|minutes)$/.test(token)) {
+    return 60;
+  }
+  if (/^(h|hr|hrs|hour|hours)$/.test(token)) {
+    return 3600;
+  }
+  return 0;
+}
+
+function parsePace(token, imperial) {
+  var parts = String(token).split(':');
+  var seconds = parseInt(parts[0], 10) * 60 + (parts.length > 1 ? parseInt(parts[1], 10) : 0);
+  if (!(seconds > 0)) {
+    throw new Error('bad pace "' + token + '"');
+  }
+  return imperial ? Math.round(seconds * 1000 / METERS_PER_MILE) : seconds;
+}
+
+function parseSequence(tokens, state, imperial, closing) {
+  var items = [];
+  while (state.i < tokens.length && tokens[state.i] !== closing) {
+    var count = tokens[state.i];
+    if (/^\d+$/.test(count) && tokens[state.i + 1] === 'x' && tokens[state.i + 2] === '(') {
+      state.i += 3;
+      var body = parseSequence(tokens, state, imperial, ')');
+      if (tokens[state.i] !== ')') {
+        throw new Error('missing ")"');
+      }
+      state.i++;
+      items.push({ repeat: parseInt(count, 10), body: body });
+    } else {
+      items.push(parseStep(tokens, state, imperial));
+    }
+    if (tokens[state.i] === ',') {
+      state.i++;
+    }
+  }
+  return items;
+}
+
+function parseStep(tokens, state, imperial) {
+  var amount = parseInt(tokens[state.i], 10);
+  if (!(amount > 0)) {
+    throw new Error('expected a duration near "' + (tokens[state.i] || 'end') + '"');
+  }
+  state.i++;
+  var unit = parseDurationUnit(tokens[state.i]);
+  if (unit) {
+    state.i++;
+  } else {
+    unit = 60;
+  }
+  var intensity = INTENSITIES[tokens[state.i]];
+  if (intensity === undefined) {
+    throw new Error('unknown intensity "' + (tokens[state.i] || 'end') + '"');
+  }
+  state.i++;
+  var pace = 0;
+  if (tokens[state.i] === '@') {
+    pace = parsePace(tokens[state.i + 1], imperial);
+    state.i += 2;
+  }
+  var duration = amount * unit;
+  if (duration > 0xFFFF) {
+    throw new Error('step longer than 18 h');
+  }
+  return { duration_s: duration, intensity: intensity, pace_s_per_km: pace };
+}
+
+function emit(items, out) {
+  items.forEach(function(item) {
+    if (item.repeat) {
+      var start = out.length;
+      emit(item.body, out);
+      if (item.repeat > 1) {
+        out.push([OP_REPEAT, Math.min(item.repeat, 255), start, 0]);
+      }
+    } else {
+      out.push([OP_STEP, item.intensity, item.duration_s, item.pace_s_per_km]);
+    }
+  });
+}
+
+// Returns { bytes, instructions } or throws with a user-facing message. An empty definition compiles to a
+// lone END, which clears the workout on the watch.
+function compile(text, imperial) {
+  var tokens = tokenize(text);
+  var state = { i: 0 };
+  var items = parseSequence(tokens, state, imperial, null);
+  if (state.i !== tokens.length) {
+    throw new Error('unexpected "' + tokens[state.i] + '"');
+  }
+  var program = [];
+  emit(items, program);
+  program.push([OP_END, 0, 0, 0]);
+  if (program.length > MAX_INSTR) {
+    throw new Error('workout too long (' + program.length + ' of ' + MAX_INSTR + ' instructions)');
+  }
+  var bytes = [];
+  program.forEach(function(instr) {
+    bytes.push(instr[0], instr[1], instr[2] & 0xFF, (instr[2] >> 8) & 0xFF, instr[3] & 0xFF, (instr[3] >> 8) & 0xFF);
+  });
+  return { bytes: bytes, instructions: program.length };
+}
+
+// compile() and its helpers as page script, so the config page can reject a bad definition
+// before saving instead of the phone finding out after the page has closed.
+function pageSource() {
+  var constants = 'var MAX_INSTR=' + MAX_INSTR + ',OP_END=' + OP_END + ',OP_STEP=' + OP_STEP +
+    ',OP_REPEAT=' + OP_REPEAT + ',INTENSITIES=' + JSON.stringify(INTENSITIES) +
+    ',METERS_PER_MILE=' + METERS_PER_MILE + ';';
+  var functions = [tokenize, parseDurationUnit, parsePace, parseSequence, parseStep, emit, compile].map(function(fn) {
+    return fn.toString().replace(/\n\s+/g, '\n');
+  });
+  return 'var workout=(function(){' + constants + functions.join('\n') + '\nreturn{compile:compile};})();';
+}
+
+module.exports = {
+  INSTR_BYTES: INSTR_BYTES,
+  compile: compile,
+  pageSource: pageSource
+};